@@ -23,15 +23,21 @@
 #	include <b6b/obj.h>
 #	include <b6b/hash.h>
 #	include <b6b/str.h>
+#	include <b6b/utf8.h>
 #	include <b6b/int.h>
 #	include <b6b/float.h>
 #	include <b6b/list.h>
 #	include <b6b/dict.h>
+#	include <b6b/buf.h>
 #	include <b6b/frame.h>
 #	include <b6b/thread.h>
 #	ifdef B6B_HAVE_OFFLOAD_THREAD
 #		include <b6b/offload.h>
 #	endif
+#	ifdef B6B_HAVE_THREADS
+#		include <b6b/reactor.h>
+#	endif
+#	include <b6b/uring.h>
 #	include <b6b/interp.h>
 #	include <b6b/proc.h>
 #	include <b6b/ext.h>
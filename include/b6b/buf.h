@@ -0,0 +1,58 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2026 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/types.h>
+
+/* a growable byte buffer: data is consumed from the front and appended at the
+ * back, and the unconsumed data is always followed by a \0 byte */
+struct b6b_buf {
+	char *data;
+	size_t off;
+	size_t len;
+	size_t size;
+};
+
+static inline void b6b_buf_init(struct b6b_buf *buf)
+{
+	buf->data = NULL;
+	buf->off = 0;
+	buf->len = 0;
+	buf->size = 0;
+}
+
+static inline void b6b_buf_free(struct b6b_buf *buf)
+{
+	free(buf->data);
+}
+
+#define b6b_buf_head(buf) ((buf)->data + (buf)->off)
+#define b6b_buf_tail(buf) (b6b_buf_head(buf) + (buf)->len)
+
+unsigned char *b6b_buf_reserve(struct b6b_buf *buf, const size_t len);
+
+static inline void b6b_buf_commit(struct b6b_buf *buf, const size_t len)
+{
+	buf->len += len;
+	b6b_buf_tail(buf)[0] = '\0';
+}
+
+int b6b_buf_append(struct b6b_buf *buf, const char *s, const size_t len);
+void b6b_buf_consume(struct b6b_buf *buf, const size_t len);
+struct b6b_obj *b6b_buf_take(struct b6b_buf *buf, const size_t len);
+
+struct b6b_buf *b6b_buf_get(struct b6b_obj *o);
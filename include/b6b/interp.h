@@ -18,8 +18,10 @@
 
 #include <inttypes.h>
 
-#define B6B_QUANT_LEN 16
-#define B6B_OFFLOAD_MAX 16
+/* the default time slice, in nanoseconds */
+#define B6B_QUANT (1000 * 1000)
+/* the number of statements between checks of the time slice */
+#define B6B_QUANT_STMTS 64
 
 enum b6b_interp_opts {
 	B6B_OPT_CMD     = 1,
@@ -32,8 +34,20 @@ enum b6b_interp_opts {
 struct b6b_interp {
 #ifdef B6B_HAVE_THREADS
 	struct b6b_threads threads;
+	struct b6b_threads runq;
+	struct b6b_threads doneq;
+	/* threads waiting for another thread, e.g. on a channel */
+	struct b6b_threads blocked;
+	/* sleeping threads, sorted by deadline */
+	struct b6b_threads sleeping;
+	struct b6b_reactor reactor;
+#	ifdef B6B_HAVE_IO_URING
+	struct b6b_uring uring;
+#	endif
 #	ifdef B6B_HAVE_OFFLOAD_THREAD
-	struct b6b_offload_thread offths[B6B_OFFLOAD_MAX];
+	struct b6b_offload_pool offpool;
+	/* threads waiting for a free slot in the offload queue */
+	struct b6b_threads offwq;
 #	endif
 #endif
 	struct b6b_thread *fg;
@@ -45,15 +59,22 @@ struct b6b_interp {
 	struct b6b_obj *at;
 	struct b6b_obj *_;
 #ifdef B6B_HAVE_THREADS
-	long stksiz;
+	struct b6b_stacks stks;
 	int exit;
 #endif
 #if defined(B6B_HAVE_THREADS) && defined(B6B_HAVE_OFFLOAD_THREAD)
-	unsigned int noffths;
+	unsigned int nbusy;
 #endif
 	unsigned int seed;
 #ifdef B6B_HAVE_THREADS
-	uint8_t qstep;
+	/* the length of a time slice, in nanoseconds, and the beginning of the
+	 * current one, or 0 if the current thread is preempted */
+	uint64_t quant;
+	uint64_t qstart;
+	/* the last time b6b_yield() polled file descriptors */
+	uint64_t polled;
+	/* the number of statements since the time slice was last checked */
+	unsigned int nstmts;
 #endif
 	uint8_t opts;
 };
@@ -66,6 +87,22 @@ static inline int b6b_threaded(struct b6b_interp *interp)
 	return (t && b6b_thread_next(t)) ? 1 : 0;
 }
 
+/* sets the length of a time slice, in nanoseconds; if 0, threads are switched
+ * after every statement */
+static inline void b6b_set_quantum(struct b6b_interp *interp,
+                                   const uint64_t ns)
+{
+	interp->quant = ns;
+}
+
+/* sets the default stack size of threads, in bytes; returns 0 if it's smaller
+ * than B6B_STACK_PAGES pages */
+static inline int b6b_set_stack_size(struct b6b_interp *interp,
+                                     const size_t size)
+{
+	return b6b_stacks_set_size(&interp->stks, size);
+}
+
 #else
 
 static inline int b6b_threaded(struct b6b_interp *interp)
@@ -73,6 +110,17 @@ static inline int b6b_threaded(struct b6b_interp *interp)
 	return 0;
 }
 
+static inline void b6b_set_quantum(struct b6b_interp *interp,
+                                   const uint64_t ns)
+{
+}
+
+static inline int b6b_set_stack_size(struct b6b_interp *interp,
+                                     const size_t size)
+{
+	return 1;
+}
+
 #endif
 
 int b6b_interp_new(struct b6b_interp *interp,
@@ -105,11 +153,36 @@ enum b6b_res b6b_call(struct b6b_interp *interp, struct b6b_obj *stmts);
 enum b6b_res b6b_call_copy(struct b6b_interp *interp,
                            const char *s,
                            const size_t len);
+/* calls a procedure with a NULL-terminated list of arguments, without
+ * evaluating them */
+__attribute__((sentinel))
+enum b6b_res b6b_call_proc(struct b6b_interp *interp,
+                           struct b6b_obj *proc,
+                           ...);
 #ifdef B6B_HAVE_THREADS
-int b6b_start(struct b6b_interp *interp, struct b6b_obj *stmts);
+int b6b_start(struct b6b_interp *interp,
+              struct b6b_obj *stmts,
+              const size_t stksiz,
+              const int prio);
+/* like b6b_start(), but returns a handle that can be used to wait for the
+ * thread and receive its result */
+struct b6b_obj *b6b_spawn(struct b6b_interp *interp,
+                          struct b6b_obj *stmts,
+                          const size_t stksiz,
+                          const int prio);
+/* starts a thread that runs entry, which receives the interpreter and must
+ * call b6b_stop() instead of returning; fn is referenced by the thread */
+int b6b_start_thread(struct b6b_interp *interp,
+                     b6b_thread_entry entry,
+                     struct b6b_obj *fn,
+                     const size_t stksiz,
+                     const int prio);
 #endif
 enum b6b_res b6b_source(struct b6b_interp *interp, const char *path);
 
+/* returns the monotonic time, in nanoseconds */
+uint64_t b6b_now(void);
+
 static inline enum b6b_res b6b_return(struct b6b_interp *interp,
                                       struct b6b_obj *o)
 {
@@ -157,8 +230,36 @@ unsigned int b6b_args_parse(struct b6b_interp *interp,
                             const char *fmt,
                             ...);
 
+enum b6b_io_events {
+	B6B_IO_IN  = 1,
+	B6B_IO_OUT = 1 << 1
+};
+
 #ifdef B6B_HAVE_THREADS
 int b6b_yield(struct b6b_interp *interp);
+int b6b_park(struct b6b_interp *interp);
+/* terminates the current thread; never returns */
+void b6b_stop(struct b6b_interp *interp);
+void b6b_wake(struct b6b_interp *interp, struct b6b_thread *t);
+/* parks the current thread until another thread calls b6b_unblock(); returns
+ * 0 if no thread can do that or the interpreter is exiting */
+int b6b_block(struct b6b_interp *interp);
+void b6b_unblock(struct b6b_interp *interp, struct b6b_thread *t);
+/* blocks the current thread until another thread calls b6b_notify() or
+ * b6b_notify_all() with q */
+int b6b_wait_on(struct b6b_interp *interp, struct b6b_waitq *q);
+void b6b_notify(struct b6b_interp *interp, struct b6b_waitq *q);
+void b6b_notify_all(struct b6b_interp *interp, struct b6b_waitq *q);
+/* parks the current thread for ns nanoseconds; returns 0 if the thread cannot
+ * park or was woken up early because the interpreter is exiting */
+int b6b_sleep(struct b6b_interp *interp, const uint64_t ns);
+
+/* parks the current thread until fd is ready; returns 0 if the thread cannot
+ * park and the caller should not block */
+int b6b_io_wait(struct b6b_interp *interp,
+                const int fd,
+                const unsigned int events);
+int b6b_io_poll(struct b6b_interp *interp, const int timeout);
 #else
 
 static inline int b6b_yield(struct b6b_interp *interp)
@@ -166,6 +267,18 @@ static inline int b6b_yield(struct b6b_interp *interp)
 	return 0;
 }
 
+static inline int b6b_io_wait(struct b6b_interp *interp,
+                              const int fd,
+                              const unsigned int events)
+{
+	return 0;
+}
+
+static inline int b6b_sleep(struct b6b_interp *interp, const uint64_t ns)
+{
+	return 0;
+}
+
 #endif
 
 #ifdef B6B_HAVE_OFFLOAD_THREAD
@@ -174,6 +287,22 @@ int b6b_offload(struct b6b_interp *interp,
                 void (*fn)(void *),
                 void *arg);
 
+/* like b6b_offload(), but the calling thread gives up after timeout
+ * nanoseconds; arg must stay valid until the job is done, so on failure, it's
+ * freed through del, maybe later */
+int b6b_offload_timeout(struct b6b_interp *interp,
+                        void (*fn)(void *),
+                        void *arg,
+                        void (*del)(void *),
+                        const uint64_t timeout);
+
+/* runs fn once for each of n arguments, on multiple offload threads at once;
+ * the calling thread waits until all jobs are done */
+int b6b_offload_batch(struct b6b_interp *interp,
+                      void (*fn)(void *),
+                      void **args,
+                      const size_t n);
+
 #else
 
 static inline int b6b_offload(struct b6b_interp *interp,
@@ -184,6 +313,29 @@ static inline int b6b_offload(struct b6b_interp *interp,
 	return 1;
 }
 
+static inline int b6b_offload_timeout(struct b6b_interp *interp,
+                                      void (*fn)(void *),
+                                      void *arg,
+                                      void (*del)(void *),
+                                      const uint64_t timeout)
+{
+	fn(arg);
+	return 1;
+}
+
+static inline int b6b_offload_batch(struct b6b_interp *interp,
+                                    void (*fn)(void *),
+                                    void **args,
+                                    const size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; ++i)
+		fn(args[i]);
+
+	return 1;
+}
+
 #endif
 
 struct b6b_syscall_data {
@@ -196,3 +348,14 @@ int b6b_syscall(struct b6b_interp *interp,
                 int *ret,
                 const long nr,
                 ...);
+
+struct epoll_event;
+
+/* like epoll_wait(), but lets other threads run while the calling thread
+ * waits; returns 0 if it cannot wait */
+int b6b_epoll_wait(struct b6b_interp *interp,
+                   const int epfd,
+                   struct epoll_event *evs,
+                   const int n,
+                   const int timeout,
+                   int *ret);
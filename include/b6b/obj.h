@@ -47,12 +47,22 @@ enum b6b_obj_flags {
 	B6B_TYPE_STR   = 1 << 1,
 	B6B_TYPE_INT   = 1 << 2,
 	B6B_TYPE_FLOAT = 1 << 3,
-	B6B_OBJ_HASHED = 1 << 4
+	B6B_OBJ_HASHED = 1 << 4,
+	B6B_STR_UTF8   = 1 << 5, /* the string is valid UTF-8 */
+	B6B_STR_ASCII  = 1 << 6  /* the string is pure ASCII */
 };
 
 typedef enum b6b_res (*b6b_procf)(struct b6b_interp *, struct b6b_obj *);
 typedef void (*b6b_delf)(void *);
 
+/* data derived from the string representation of an object, like a parsed
+ * format, which is freed when the string is; each kind of data is identified
+ * by the function that frees it, and embeds this as its first member */
+struct b6b_cache {
+	struct b6b_cache *next;
+	b6b_delf del;
+};
+
 struct b6b_obj {
 	struct b6b_lhead l;
 	char *s;
@@ -62,6 +72,7 @@ struct b6b_obj {
 	b6b_procf proc;
 	b6b_delf del;
 	void *priv;
+	struct b6b_cache *cache;
 	int refc;
 	uint32_t hash;
 	uint8_t flags;
@@ -98,6 +109,29 @@ static inline void b6b_unref(struct b6b_obj *o)
 		b6b_destroy(o);
 }
 
+static inline void *b6b_cache_get(const struct b6b_obj *o, b6b_delf del)
+{
+	struct b6b_cache *c;
+
+	for (c = o->cache; c; c = c->next) {
+		if (c->del == del)
+			return c;
+	}
+
+	return NULL;
+}
+
+static inline void b6b_cache_add(struct b6b_obj *o,
+                                 struct b6b_cache *c,
+                                 b6b_delf del)
+{
+	c->del = del;
+	c->next = o->cache;
+	o->cache = c;
+}
+
+void b6b_cache_flush(struct b6b_obj *o);
+
 int b6b_obj_hash(struct b6b_obj *o);
 static inline int b6b_obj_eq(struct b6b_obj *a, struct b6b_obj *b)
 {
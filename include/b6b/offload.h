@@ -1,7 +1,7 @@
 /*
  * This file is part of b6b.
  *
- * Copyright 2017, 2020 Dima Krasner
+ * Copyright 2017, 2020, 2026 Dima Krasner
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -23,52 +23,138 @@
 #	include <valgrind/helgrind.h>
 #endif
 
-/* simple state machine: b6b_offload_thread.state is B6B_OFFLOAD_IDLE when no
- * offload is running, transitions to B6B_OFFLOAD_RUNNING before preparations
- * for execution and to B6B_OFFLOAD_DONE when the offload returns */
-enum b6b_offload_state {
-	B6B_OFFLOAD_INIT,
-	B6B_OFFLOAD_UP,
-	B6B_OFFLOAD_IDLE,
-	B6B_OFFLOAD_RUNNING,
-	B6B_OFFLOAD_DONE
+/* the maximum number of offload threads */
+#define B6B_OFFLOAD_MAX 64
+/* the default limit on the number of offload threads, which can be overridden
+ * through the environment */
+#define B6B_OFFLOAD_THREADS 16
+#define B6B_OFFLOAD_THREADS_ENV "B6B_OFFLOAD_THREADS"
+/* the number of seconds an offload thread waits for a job before it exits */
+#define B6B_OFFLOAD_IDLE_TIMEOUT 10
+/* the maximum number of queued jobs; must be a power of 2 */
+#define B6B_OFFLOAD_QLEN 64
+
+enum b6b_offload_job_state {
+	B6B_OFFLOAD_JOB_QUEUED,
+	B6B_OFFLOAD_JOB_RUNNING,
+	B6B_OFFLOAD_JOB_DONE,
+	/* the interpreter exited while the job was running, so the offload thread
+	 * must not touch the pool once the job is done, and frees the job */
+	B6B_OFFLOAD_JOB_DETACHED
 };
 
-struct b6b_offload_thread {
-	sigset_t mask;
-	sigset_t wmask;
-	pthread_t tid;
-	pthread_t main;
+struct b6b_offload_job {
 	void (*fn)(void *);
 	void *arg;
+	/* the b6b thread waiting for completion */
+	struct b6b_thread *waiter;
+	/* the next job in the completion queue */
+	struct b6b_offload_job *next;
+	/* frees arg once a job that timed out is done */
+	void (*del)(void *);
+	/* if the job is part of a batch, the number of jobs in the batch that
+	 * aren't done yet */
+	size_t *left;
+	/* set if the waiting thread sleeps until a deadline */
+	int timed;
+	int done;
+	/* set if the waiting thread gave up */
+	int abandoned;
 	atomic_int state;
-	int sig;
 };
 
-static inline void b6b_offload_thread_init(struct b6b_offload_thread *t)
-{
-	atomic_store(&t->state, B6B_OFFLOAD_INIT);
+struct b6b_offload_slot {
+	/* the position of the job in the queue, plus 1 if a job is queued */
+	atomic_size_t seq;
+	struct b6b_offload_job *job;
+};
 
-#ifdef B6B_HAVE_VALGRIND
-	/* all operations on t->state are atomic */
-	VALGRIND_HG_DISABLE_CHECKING(&t->state, sizeof(t->state));
+enum b6b_offload_worker_state {
+	B6B_OFFLOAD_FREE,
+	B6B_OFFLOAD_RUNNING,
+	/* the offload thread exited and should be joined */
+	B6B_OFFLOAD_EXITED
+};
 
-	/* stores are guarded by t->state and loads happen only after delivery of
-	 * t->sig */
-	VALGRIND_HG_DISABLE_CHECKING(&t->fn, sizeof(t->fn));
-	VALGRIND_HG_DISABLE_CHECKING(&t->arg, sizeof(t->arg));
-#endif
-}
+struct b6b_offload_worker {
+	struct b6b_offload_pool *pool;
+	pthread_t tid;
+	atomic_int state;
+	/* the job the offload thread is running */
+	_Atomic(struct b6b_offload_job *) job;
+};
+
+/* the interpreter thread queues jobs and offload threads dequeue them, without
+ * locks; offload threads sleep on a futex while the queue is empty and push
+ * completed jobs to a stack, which the interpreter thread drains
+ *
+ * offload threads are spawned on demand, when a job is queued and all offload
+ * threads are busy, and exit after B6B_OFFLOAD_IDLE_TIMEOUT seconds without a
+ * job */
+struct b6b_offload_pool {
+	struct b6b_offload_slot q[B6B_OFFLOAD_QLEN];
+	/* the next slot to dequeue from, shared by all offload threads */
+	atomic_size_t head;
+	/* the next slot to enqueue to, used only by the interpreter thread */
+	size_t tail;
+	/* a futex, incremented whenever a job is queued */
+	atomic_int jobs;
+	/* the number of offload threads sleeping on jobs */
+	atomic_int nidle;
+	_Atomic(struct b6b_offload_job *) done;
+	/* set while the interpreter thread sleeps until a job is done: only then,
+	 * offload threads signal the eventfd */
+	atomic_int waiting;
+	atomic_int stop;
+	/* becomes readable when a job is done while the interpreter thread is
+	 * waiting, so the reactor can sleep until then */
+	int efd;
+	struct b6b_offload_worker workers[B6B_OFFLOAD_MAX];
+	/* the number of running offload threads */
+	atomic_uint nthreads;
+	/* the maximum number of offload threads */
+	unsigned int max;
+	/* the idle timeout of offload threads, in seconds */
+	unsigned int timeout;
+	/* the number of offload threads stuck in jobs that timed out, which don't
+	 * count towards max; accessed only by the interpreter thread */
+	unsigned int nabandoned;
+};
+
+/* prepares a pool of up to max offload threads, without spawning any */
+int b6b_offload_pool_start(struct b6b_offload_pool *pool,
+                           const unsigned int max);
+void b6b_offload_pool_stop(struct b6b_offload_pool *pool);
+
+/* creates the eventfd on first use; returns 0 on failure */
+int b6b_offload_pool_open(struct b6b_offload_pool *pool);
 
-int b6b_offload_thread_start(struct b6b_offload_thread *t, const int id);
-void b6b_offload_thread_stop(struct b6b_offload_thread *t);
+/* queues a job; returns 0 if the queue is full */
+int b6b_offload_submit(struct b6b_offload_pool *pool,
+                       struct b6b_offload_job *job);
+
+/* returns the list of jobs that are done, in the order of completion */
+struct b6b_offload_job *b6b_offload_reap(struct b6b_offload_pool *pool);
+
+#define b6b_offload_pending(pool) (atomic_load(&(pool)->done) != NULL)
+
+/* asks offload threads to signal the interpreter thread once a job is done;
+ * returns 0 if there already is such a job */
+static inline int b6b_offload_arm(struct b6b_offload_pool *pool)
+{
+	atomic_store(&pool->waiting, 1);
+	if (b6b_offload_pending(pool)) {
+		atomic_store(&pool->waiting, 0);
+		return 0;
+	}
+
+	return 1;
+}
 
-/* these two macros are used to poll the state machine */
-#define b6b_offload_ready(t) (atomic_load(&(t)->state) == B6B_OFFLOAD_IDLE)
-#define b6b_offload_done(t) (atomic_load(&(t)->state) == B6B_OFFLOAD_DONE)
+#define b6b_offload_disarm(pool) atomic_store(&(pool)->waiting, 0)
 
-int b6b_offload_start(struct b6b_offload_thread *t,
-                      void (*fn)(void *),
-                      void *arg);
+/* blocks until at least one job is done */
+int b6b_offload_wait(struct b6b_offload_pool *pool);
 
-int b6b_offload_finish(struct b6b_offload_thread *t);
+/* resets the eventfd after it became readable */
+void b6b_offload_drain(struct b6b_offload_pool *pool);
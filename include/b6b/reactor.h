@@ -0,0 +1,63 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2026 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* threads waiting for a file descriptor, which is registered with the union of
+ * their events */
+struct b6b_io_fd {
+	struct b6b_waitq in;
+	struct b6b_waitq out;
+	uint32_t events;
+	int fd;
+};
+
+/* the reactor parks green threads until a file descriptor becomes ready; it's
+ * created on first use */
+struct b6b_reactor {
+	/* threads waiting for a file descriptor */
+	struct b6b_threads waiting;
+	/* waiters, indexed by file descriptor */
+	struct b6b_io_fd **fds;
+	int nfds;
+	int epfd;
+#ifdef B6B_HAVE_OFFLOAD_THREAD
+	/* the eventfd of the offload pool, once added to epfd */
+	int offfd;
+#endif
+#ifdef B6B_HAVE_IO_URING
+	/* the io_uring file descriptor, once added to epfd */
+	int ringfd;
+#endif
+};
+
+static inline void b6b_reactor_init(struct b6b_reactor *r)
+{
+	b6b_thread_init(&r->waiting);
+	r->fds = NULL;
+	r->nfds = 0;
+	r->epfd = -1;
+#ifdef B6B_HAVE_OFFLOAD_THREAD
+	r->offfd = -1;
+#endif
+#ifdef B6B_HAVE_IO_URING
+	r->ringfd = -1;
+#endif
+}
+
+#define b6b_reactor_busy(r) (b6b_thread_queued(&(r)->waiting) != NULL)
+
+void b6b_reactor_destroy(struct b6b_reactor *r);
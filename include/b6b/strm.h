@@ -46,6 +46,13 @@ enum b6b_strm_flags {
 struct b6b_strm {
 	const struct b6b_strm_ops *ops;
 	void *priv;
+	/* data read ahead by readline, readuntil or readexact */
+	struct b6b_buf rbuf;
+	/* the last delimiter searched for in rbuf, and where the search should
+	 * continue once there's more data */
+	char *delim;
+	size_t dlen;
+	size_t scan;
 	uint8_t flags;
 };
 
@@ -58,3 +65,11 @@ struct b6b_obj *b6b_strm_fmt(struct b6b_interp *interp,
                              const struct b6b_strm_ops *ops,
                              void *priv,
                              const char *type);
+
+/* returns the file descriptor of a stream object, or -1 if it's closed or not
+ * a stream */
+int b6b_strm_obj_fd(struct b6b_obj *o);
+void b6b_strm_obj_close(struct b6b_obj *o);
+
+/* creates a timer stream that becomes readable every f seconds */
+struct b6b_obj *b6b_timer_new(struct b6b_interp *interp, const b6b_float f);
@@ -18,7 +18,18 @@
 
 #ifdef B6B_HAVE_THREADS
 
-#	include <ucontext.h>
+/* on x86-64 and aarch64, we switch between threads by saving and restoring
+ * callee-saved registers and the stack pointer; elsewhere, or when building
+ * with AddressSanitizer (which must be notified about stack switches), we fall
+ * back to ucontext, which also saves and restores the signal mask through a
+ * system call */
+#	if (defined(__x86_64__) || defined(__aarch64__)) && \
+	   defined(__ELF__) && \
+	   !defined(__SANITIZE_ADDRESS__)
+#		define B6B_HAVE_CTX_SWAP
+#	else
+#		include <ucontext.h>
+#	endif
 
 #	include <sys/queue.h>
 
@@ -26,21 +37,64 @@ enum b6b_thread_flags {
 	B6B_THREAD_BG      = 1,
 	B6B_THREAD_FG      = 1 << 1,
 	B6B_THREAD_DONE    = 1 << 2,
-	B6B_THREAD_BLOCKED = 1 << 3
+	B6B_THREAD_PARKED  = 1 << 3
+};
+
+/* the default stack size, in pages */
+#	define B6B_STACK_PAGES 16
+
+/* the maximum number of unused stacks kept for reuse */
+#	define B6B_STACKS_MAX 64
+
+/* an unused stack: the list entry resides at the top of the stack, which is
+ * always touched when a thread runs */
+struct b6b_stack {
+	struct b6b_stack *next;
+	/* the default stack size may change while the stack is unused */
+	size_t size;
 };
 
+struct b6b_stacks {
+	struct b6b_stack *free;
+	size_t pgsiz;
+	size_t size;
+	unsigned int nfree;
+};
+
+struct b6b_thread;
+
+typedef void (*b6b_thread_entry)(struct b6b_thread *, void *);
+
 TAILQ_HEAD(b6b_threads, b6b_thread);
+TAILQ_HEAD(b6b_locks, b6b_lock);
 struct b6b_thread {
+#	ifdef B6B_HAVE_CTX_SWAP
+	void *sp;
+#	else
 	ucontext_t ucp;
+#	endif
 	void *stack;
+	size_t stksiz;
+	struct b6b_stacks *stks;
+	b6b_thread_entry entry;
+	void *arg;
 	struct b6b_frame *curr;
 	struct b6b_obj *fn;
 	struct b6b_obj *_;
 	TAILQ_ENTRY(b6b_thread) ents;
+	/* the run queue, done queue, wait queue or sleep queue the thread resides
+	 * in */
+	TAILQ_ENTRY(b6b_thread) qents;
 #	ifdef B6B_HAVE_VALGRIND
 	int sid;
 #	endif
 	unsigned int depth;
+	/* when a sleeping thread should wake up */
+	uint64_t deadline;
+	/* a runnable thread preempts the current one if its priority is higher */
+	int prio;
+	/* locks held by the thread, released when it's done */
+	struct b6b_locks locks;
 	uint8_t flags;
 };
 
@@ -54,30 +108,91 @@ struct b6b_thread *b6b_thread_new(struct b6b_threads *threads,
                                   struct b6b_obj *fn,
                                   struct b6b_frame *global,
                                   struct b6b_obj *null,
-                                  void (*routine)(int, int, int, int),
-                                  void *priv,
+                                  b6b_thread_entry entry,
+                                  void *arg,
+                                  struct b6b_stacks *stks,
                                   const size_t stksiz);
 
+#	define b6b_thread_enqueue(q, t) TAILQ_INSERT_TAIL(q, t, qents)
+#	define b6b_thread_dequeue(q, t) TAILQ_REMOVE(q, t, qents)
+#	define b6b_thread_queued(q) TAILQ_FIRST(q)
+
 static inline void b6b_thread_push(struct b6b_threads *threads,
-                                   struct b6b_thread *t,
-                                   struct b6b_thread *fg)
+                                   struct b6b_threads *runq,
+                                   struct b6b_thread *t)
 {
-	/* if this isn't the first thread, we want to let it run immediately */
-	if (fg)
-		TAILQ_INSERT_AFTER(threads, fg, t, ents);
-	else
-		TAILQ_INSERT_TAIL(threads, t, ents);
+	TAILQ_INSERT_TAIL(threads, t, ents);
+
+	/* we want to let the new thread run immediately */
+	TAILQ_INSERT_HEAD(runq, t, qents);
 }
 
 void b6b_thread_pop(struct b6b_threads *ts, struct b6b_thread *t);
+
+int b6b_stacks_init(struct b6b_stacks *stks, const size_t pages);
+/* changes the default stack size, which cannot be smaller than
+ * B6B_STACK_PAGES pages, and frees unused stacks */
+int b6b_stacks_set_size(struct b6b_stacks *stks, const size_t size);
+void b6b_stacks_destroy(struct b6b_stacks *stks);
 void b6b_thread_swap(struct b6b_thread *bg, struct b6b_thread *fg);
 
-#	define b6b_thread_block(t) \
-	(t)->flags |= B6B_THREAD_BLOCKED
-#	define b6b_thread_unblock(t) \
-	(t)->flags &= ~B6B_THREAD_BLOCKED
-#	define b6b_thread_blocked(t) \
-	((t)->flags & B6B_THREAD_BLOCKED)
+#	define b6b_thread_parked(t) ((t)->flags & B6B_THREAD_PARKED)
+
+/* a blocked thread in a queue of threads waiting for an object, e.g. a
+ * channel; a thread may wait for multiple objects at once */
+struct b6b_waiter {
+	TAILQ_ENTRY(b6b_waiter) ents;
+	struct b6b_thread *t;
+	int queued;
+};
+
+TAILQ_HEAD(b6b_waitq, b6b_waiter);
+
+#	define b6b_waitq_init(q) TAILQ_INIT(q)
+
+static inline void b6b_waitq_add(struct b6b_waitq *q,
+                                 struct b6b_waiter *w,
+                                 struct b6b_thread *t)
+{
+	w->t = t;
+	w->queued = 1;
+	TAILQ_INSERT_TAIL(q, w, ents);
+}
+
+static inline void b6b_waitq_del(struct b6b_waitq *q, struct b6b_waiter *w)
+{
+	if (w->queued)
+		TAILQ_REMOVE(q, w, ents);
+}
+
+/* a lock held by one thread at a time, e.g. a mutex */
+struct b6b_lock {
+	TAILQ_ENTRY(b6b_lock) ents;
+	/* the thread that holds the lock, or NULL */
+	struct b6b_thread *owner;
+	struct b6b_waitq waiters;
+};
+
+#	define b6b_locks_init(h) TAILQ_INIT(h)
+#	define b6b_lock_held(t) TAILQ_FIRST(&(t)->locks)
+
+static inline void b6b_lock_init(struct b6b_lock *l)
+{
+	l->owner = NULL;
+	b6b_waitq_init(&l->waiters);
+}
+
+static inline void b6b_lock_take(struct b6b_lock *l, struct b6b_thread *t)
+{
+	l->owner = t;
+	TAILQ_INSERT_TAIL(&t->locks, l, ents);
+}
+
+static inline void b6b_lock_drop(struct b6b_lock *l)
+{
+	TAILQ_REMOVE(&l->owner->locks, l, ents);
+	l->owner = NULL;
+}
 
 #else
 
@@ -0,0 +1,115 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2026 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/types.h>
+
+struct b6b_interp;
+
+#ifdef B6B_HAVE_IO_URING
+
+#	include <linux/io_uring.h>
+
+#	define B6B_URING_ENTRIES 256
+/* if set, operations are always offloaded */
+#	define B6B_URING_DISABLE_ENV "B6B_NO_IO_URING"
+
+/* the io_uring instance lets green threads submit blocking operations from the
+ * interpreter thread and park until they're done, instead of handing them to
+ * offload threads; it's created on first use and operations it doesn't
+ * support are offloaded */
+struct b6b_uring {
+	int fd;
+	/* cleared if io_uring is unavailable */
+	int ok;
+	/* the opcodes supported by the kernel */
+	uint64_t ops;
+	void *rings;
+	size_t rlen;
+	struct io_uring_sqe *sqes;
+	size_t slen;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_cqe *cqes;
+	/* the next submission queue entry, published only when it's filled */
+	unsigned int tail;
+	/* the number of queued entries, not submitted yet */
+	unsigned int npending;
+	/* the number of operations threads are waiting for */
+	unsigned int nops;
+};
+
+static inline void b6b_uring_init(struct b6b_uring *r)
+{
+	r->fd = -1;
+	r->ok = 1;
+	r->npending = 0;
+	r->nops = 0;
+}
+
+void b6b_uring_destroy(struct b6b_uring *r);
+
+#	define b6b_uring_busy(r) ((r)->nops > 0)
+
+/* submits all queued operations in one system call */
+void b6b_uring_submit(struct b6b_uring *r);
+
+/* wakes threads waiting for operations that are done */
+void b6b_uring_reap(struct b6b_interp *interp);
+
+/* all these return 0 if the operation cannot be done through io_uring, or 1
+ * and the result of the operation (a negative errno value on failure) */
+
+/* opens only regular files and directories, or files that don't exist yet */
+int b6b_uring_openat(struct b6b_interp *interp,
+                     const char *path,
+                     const int flags,
+                     const mode_t mode,
+                     const uint64_t timeout,
+                     int *res);
+int b6b_uring_poll(struct b6b_interp *interp,
+                   const int fd,
+                   const unsigned int events,
+                   const int timeout,
+                   int *res);
+
+#else
+
+static inline int b6b_uring_openat(struct b6b_interp *interp,
+                                   const char *path,
+                                   const int flags,
+                                   const mode_t mode,
+                                   const uint64_t timeout,
+                                   int *res)
+{
+	return 0;
+}
+
+static inline int b6b_uring_poll(struct b6b_interp *interp,
+                                 const int fd,
+                                 const unsigned int events,
+                                 const int timeout,
+                                 int *res)
+{
+	return 0;
+}
+
+#endif
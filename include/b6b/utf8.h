@@ -0,0 +1,38 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2026 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/types.h>
+
+/* the length of a UTF-8 sequence, by its first byte; only valid for strings
+ * already known to be valid UTF-8 */
+static inline size_t b6b_utf8_cplen(const unsigned char c)
+{
+	if (c < 0x80)
+		return 1;
+
+	if (c < 0xE0)
+		return 2;
+
+	if (c < 0xF0)
+		return 3;
+
+	return 4;
+}
+
+int b6b_utf8_validate(const char *s, const size_t len, int *ascii);
+int b6b_as_utf8(struct b6b_obj *o);
@@ -163,11 +163,13 @@ static char *hint(const char *s, int *color, int *bold)
 
 int main(int argc, char *argv[]) {
 	enum b6b_res res;
+	char *end;
+	unsigned long quant = B6B_QUANT / 1000;
 	int ret = EXIT_FAILURE;
 	uint8_t opts = 0;
 
 	do {
-		switch (getopt(argc, argv, "ceux")) {
+		switch (getopt(argc, argv, "ceuxq:")) {
 			case 'c':
 				opts |= B6B_OPT_CMD;
 				break;
@@ -184,6 +186,13 @@ int main(int argc, char *argv[]) {
 				opts |= B6B_OPT_TRACE;
 				break;
 
+			case 'q':
+				quant = strtoul(optarg, &end, 10);
+				if (!*optarg || *end || (quant > UINT64_MAX / 1000))
+					return EXIT_FAILURE;
+
+				break;
+
 			case -1:
 				goto done;
 
@@ -202,6 +211,8 @@ done:
 		                         opts))
 			return EXIT_FAILURE;
 
+		b6b_set_quantum(&interp, (uint64_t)quant * 1000);
+
 		if (opts & B6B_OPT_CMD)
 			res = b6b_call_copy(&interp, argv[optind], strlen(argv[optind]));
 		else
@@ -211,6 +222,8 @@ done:
 		if (!b6b_interp_new_argv(&interp, argc, (const char **)argv, opts))
 			return EXIT_FAILURE;
 
+		b6b_set_quantum(&interp, (uint64_t)quant * 1000);
+
 		linenoiseSetCompletionCallback(complete);
 		linenoiseSetHintsCallback(hint);
 
@@ -0,0 +1,304 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2026 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+
+#include <b6b.h>
+
+#define B6B_BUF_MIN 64
+
+unsigned char *b6b_buf_reserve(struct b6b_buf *buf, const size_t len)
+{
+	char *data;
+	size_t size;
+
+	if (len > SIZE_MAX - 1 - buf->len)
+		return NULL;
+
+	if (buf->size - buf->off - buf->len > len)
+		return (unsigned char *)b6b_buf_tail(buf);
+
+	/* if at least half of the buffer is consumed data and there's enough room
+	 * once it's discarded, we move the data instead of growing the buffer */
+	if (buf->off &&
+	    (buf->off >= buf->len) &&
+	    (buf->size - buf->len > len)) {
+		memmove(buf->data, b6b_buf_head(buf), buf->len + 1);
+		buf->off = 0;
+		return (unsigned char *)b6b_buf_tail(buf);
+	}
+
+	/* we grow the buffer exponentially, so appending is amortized O(1) */
+	size = buf->size ? buf->size : B6B_BUF_MIN;
+	while (size - buf->len <= len) {
+		if (size > SIZE_MAX / 2) {
+			size = buf->len + len + 1;
+			break;
+		}
+
+		size *= 2;
+	}
+
+	if (buf->off) {
+		data = (char *)malloc(size);
+		if (!b6b_allocated(data))
+			return NULL;
+
+		memcpy(data, b6b_buf_head(buf), buf->len + 1);
+		free(buf->data);
+		buf->off = 0;
+	} else {
+		data = (char *)realloc(buf->data, size);
+		if (!b6b_allocated(data))
+			return NULL;
+
+		data[buf->len] = '\0';
+	}
+
+	buf->data = data;
+	buf->size = size;
+	return (unsigned char *)b6b_buf_tail(buf);
+}
+
+int b6b_buf_append(struct b6b_buf *buf, const char *s, const size_t len)
+{
+	unsigned char *p;
+
+	p = b6b_buf_reserve(buf, len);
+	if (b6b_unlikely(!p))
+		return 0;
+
+	memcpy(p, s, len);
+	b6b_buf_commit(buf, len);
+	return 1;
+}
+
+void b6b_buf_consume(struct b6b_buf *buf, const size_t len)
+{
+	buf->len -= len;
+
+	if (buf->len)
+		buf->off += len;
+	else if (buf->data) {
+		/* the buffer is empty, so we can start from its beginning again */
+		buf->off = 0;
+		buf->data[0] = '\0';
+	}
+}
+
+struct b6b_obj *b6b_buf_take(struct b6b_buf *buf, const size_t len)
+{
+	struct b6b_obj *o;
+	char *s;
+
+	if (!buf->data)
+		return b6b_str_copy("", 0);
+
+	/* if the entire buffer is taken, we hand its memory to the string instead
+	 * of copying */
+	if (!buf->off && (len == buf->len)) {
+		if (buf->size / 2 > len + 1) {
+			s = (char *)realloc(buf->data, len + 1);
+			if (b6b_likely(s)) {
+				buf->data = s;
+				buf->size = len + 1;
+			}
+		}
+
+		o = b6b_str_new(buf->data, len);
+		if (b6b_likely(o))
+			b6b_buf_init(buf);
+
+		return o;
+	}
+
+	o = b6b_str_copy(b6b_buf_head(buf), len);
+	if (b6b_likely(o))
+		b6b_buf_consume(buf, len);
+
+	return o;
+}
+
+static enum b6b_res b6b_buf_find(struct b6b_interp *interp,
+                                 struct b6b_buf *buf,
+                                 struct b6b_obj *sub,
+                                 const size_t start)
+{
+	const char *p;
+
+	if (sub->slen && (start <= buf->len) && (buf->len - start >= sub->slen)) {
+		p = (const char *)memmem(b6b_buf_head(buf) + start,
+		                         buf->len - start,
+		                         sub->s,
+		                         sub->slen);
+		if (p)
+			return b6b_return_int(interp, (b6b_int)(p - b6b_buf_head(buf)));
+	}
+
+	return b6b_return_int(interp, -1);
+}
+
+static enum b6b_res b6b_buf_proc(struct b6b_interp *interp,
+                                 struct b6b_obj *args)
+{
+	struct b6b_obj *o, *op, *end;
+	struct b6b_litem *li;
+	struct b6b_buf *buf;
+	unsigned int argc;
+
+	argc = b6b_proc_get_args(interp, args, "os|*", &o, &op, &li);
+	if (!argc)
+		return B6B_ERR;
+
+	buf = (struct b6b_buf *)o->priv;
+
+	if (strcmp(op->s, "append") == 0) {
+		for (; argc == 3 && li; li = b6b_list_next(li)) {
+			if (!b6b_as_str(li->o) ||
+			    !b6b_buf_append(buf, li->o->s, li->o->slen))
+				return B6B_ERR;
+		}
+
+		return B6B_OK;
+	}
+
+	if (argc == 2) {
+		if (strcmp(op->s, "len") == 0)
+			return b6b_return_int(interp, (b6b_int)buf->len);
+
+		if (strcmp(op->s, "take") == 0) {
+			o = b6b_buf_take(buf, buf->len);
+			if (b6b_unlikely(!o))
+				return B6B_ERR;
+
+			return b6b_return(interp, o);
+		}
+	} else if (!b6b_list_next(li)) {
+		if (strcmp(op->s, "find") == 0) {
+			if (!b6b_as_str(li->o))
+				return B6B_ERR;
+
+			return b6b_buf_find(interp, buf, li->o, 0);
+		}
+
+		if (!b6b_as_int(li->o) || (li->o->i < 0) || (li->o->i > buf->len))
+			return B6B_ERR;
+
+		if (strcmp(op->s, "take") == 0) {
+			o = b6b_buf_take(buf, (size_t)li->o->i);
+			if (b6b_unlikely(!o))
+				return B6B_ERR;
+
+			return b6b_return(interp, o);
+		}
+
+		if (strcmp(op->s, "consume") == 0) {
+			b6b_buf_consume(buf, (size_t)li->o->i);
+			return B6B_OK;
+		}
+	} else if (!b6b_list_next(b6b_list_next(li))) {
+		end = b6b_list_next(li)->o;
+
+		if (strcmp(op->s, "find") == 0) {
+			if (!b6b_as_str(li->o) ||
+			    !b6b_as_int(end) ||
+			    (end->i < 0) ||
+			    (end->i > buf->len))
+				return B6B_ERR;
+
+			return b6b_buf_find(interp, buf, li->o, (size_t)end->i);
+		}
+
+		if (strcmp(op->s, "range") == 0) {
+			if (!b6b_as_int(li->o) ||
+			    !b6b_as_int(end) ||
+			    (li->o->i < 0) ||
+			    (li->o->i > end->i) ||
+			    (end->i >= buf->len))
+				return B6B_ERR;
+
+			return b6b_return_str(interp,
+			                      b6b_buf_head(buf) + li->o->i,
+			                      (size_t)(end->i - li->o->i) + 1);
+		}
+	}
+
+	b6b_return_fmt(interp, "bad buf op: %s", op->s);
+	return B6B_ERR;
+}
+
+static void b6b_buf_del(void *priv)
+{
+	b6b_buf_free((struct b6b_buf *)priv);
+	free(priv);
+}
+
+struct b6b_buf *b6b_buf_get(struct b6b_obj *o)
+{
+	if (o->proc == b6b_buf_proc)
+		return (struct b6b_buf *)o->priv;
+
+	return NULL;
+}
+
+static enum b6b_res b6b_buf_proc_buf(struct b6b_interp *interp,
+                                     struct b6b_obj *args)
+{
+	struct b6b_obj *o, *s;
+	struct b6b_buf *buf;
+	unsigned int argc;
+
+	argc = b6b_proc_get_args(interp, args, "o|s", NULL, &s);
+	if (!argc)
+		return B6B_ERR;
+
+	buf = (struct b6b_buf *)malloc(sizeof(*buf));
+	if (!b6b_allocated(buf))
+		return B6B_ERR;
+
+	b6b_buf_init(buf);
+
+	if ((argc == 2) && !b6b_buf_append(buf, s->s, s->slen)) {
+		b6b_buf_del(buf);
+		return B6B_ERR;
+	}
+
+	o = b6b_str_fmt("buf:%"PRIxPTR, (uintptr_t)buf);
+	if (b6b_unlikely(!o)) {
+		b6b_buf_del(buf);
+		return B6B_ERR;
+	}
+
+	o->priv = buf;
+	o->proc = b6b_buf_proc;
+	o->del = b6b_buf_del;
+	return b6b_return(interp, o);
+}
+
+static const struct b6b_ext_obj b6b_buf[] = {
+	{
+		.name = "buf",
+		.type = B6B_TYPE_STR,
+		.val.s = "buf",
+		.proc = b6b_buf_proc_buf
+	}
+};
+__b6b_ext(b6b_buf);
@@ -0,0 +1,317 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2026 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <b6b.h>
+
+/* the initial size of the buffer of an unbounded channel */
+#define B6B_CHAN_MIN 16
+
+struct b6b_chan {
+	/* a ring of queued objects */
+	struct b6b_obj **items;
+	size_t head;
+	size_t len;
+	size_t size;
+	/* the maximum number of queued objects, or 0 if unbounded */
+	size_t cap;
+	struct b6b_waitq recvq;
+	struct b6b_waitq sendq;
+	int closed;
+};
+
+static enum b6b_res b6b_chan_proc(struct b6b_interp *interp,
+                                  struct b6b_obj *args);
+
+static struct b6b_chan *b6b_chan_get(struct b6b_obj *o)
+{
+	if (o->proc != b6b_chan_proc)
+		return NULL;
+
+	return (struct b6b_chan *)o->priv;
+}
+
+static int b6b_chan_push(struct b6b_chan *ch, struct b6b_obj *o)
+{
+	struct b6b_obj **items;
+	size_t size, i;
+
+	/* only an unbounded channel can be full here */
+	if (ch->len == ch->size) {
+		size = ch->size * 2;
+		items = (struct b6b_obj **)malloc(sizeof(struct b6b_obj *) * size);
+		if (!b6b_allocated(items))
+			return 0;
+
+		for (i = 0; i < ch->len; ++i)
+			items[i] = ch->items[(ch->head + i) % ch->size];
+
+		free(ch->items);
+		ch->items = items;
+		ch->head = 0;
+		ch->size = size;
+	}
+
+	ch->items[(ch->head + ch->len) % ch->size] = b6b_ref(o);
+	++ch->len;
+	return 1;
+}
+
+static struct b6b_obj *b6b_chan_pop(struct b6b_interp *interp,
+                                    struct b6b_chan *ch)
+{
+	struct b6b_obj *o = ch->items[ch->head];
+
+	ch->head = (ch->head + 1) % ch->size;
+	--ch->len;
+
+	/* if the channel was full, a blocked sender can proceed */
+	b6b_notify(interp, &ch->sendq);
+	return o;
+}
+
+static enum b6b_res b6b_chan_closed(struct b6b_interp *interp)
+{
+	b6b_return_str(interp, "closed chan", sizeof("closed chan") - 1);
+	return B6B_ERR;
+}
+
+static enum b6b_res b6b_chan_send(struct b6b_interp *interp,
+                                  struct b6b_chan *ch,
+                                  struct b6b_obj *o)
+{
+	while (!ch->closed && ch->cap && (ch->len == ch->cap)) {
+		if (!b6b_wait_on(interp, &ch->sendq))
+			return B6B_ERR;
+	}
+
+	if (ch->closed)
+		return b6b_chan_closed(interp);
+
+	if (b6b_unlikely(!b6b_chan_push(ch, o)))
+		return B6B_ERR;
+
+	b6b_notify(interp, &ch->recvq);
+	return B6B_OK;
+}
+
+static enum b6b_res b6b_chan_recv(struct b6b_interp *interp,
+                                  struct b6b_chan *ch)
+{
+	/* a closed channel is drained before receiving from it fails */
+	while (!ch->len) {
+		if (ch->closed)
+			return b6b_chan_closed(interp);
+
+		if (!b6b_wait_on(interp, &ch->recvq))
+			return B6B_ERR;
+	}
+
+	return b6b_return(interp, b6b_chan_pop(interp, ch));
+}
+
+static void b6b_chan_close(struct b6b_interp *interp, struct b6b_chan *ch)
+{
+	ch->closed = 1;
+	b6b_notify_all(interp, &ch->recvq);
+	b6b_notify_all(interp, &ch->sendq);
+}
+
+static enum b6b_res b6b_chan_proc(struct b6b_interp *interp,
+                                  struct b6b_obj *args)
+{
+	struct b6b_obj *o, *op, *arg;
+	struct b6b_chan *ch;
+	unsigned int argc;
+
+	argc = b6b_proc_get_args(interp, args, "os|o", &o, &op, &arg);
+	if (!argc)
+		return B6B_ERR;
+
+	ch = (struct b6b_chan *)o->priv;
+
+	switch (argc) {
+		case 2:
+			if (strcmp(op->s, "recv") == 0)
+				return b6b_chan_recv(interp, ch);
+			else if (strcmp(op->s, "len") == 0)
+				return b6b_return_int(interp, (b6b_int)ch->len);
+			else if (strcmp(op->s, "close") == 0) {
+				b6b_chan_close(interp, ch);
+				return B6B_OK;
+			}
+			break;
+
+		case 3:
+			if (strcmp(op->s, "send") == 0)
+				return b6b_chan_send(interp, ch, arg);
+			break;
+	}
+
+	if (argc >= 2)
+		b6b_return_fmt(interp, "bad chan op: %s", op->s);
+
+	return B6B_ERR;
+}
+
+static void b6b_chan_del(void *priv)
+{
+	struct b6b_chan *ch = (struct b6b_chan *)priv;
+
+	for (; ch->len; --ch->len, ch->head = (ch->head + 1) % ch->size)
+		b6b_unref(ch->items[ch->head]);
+
+	free(ch->items);
+	free(ch);
+}
+
+static enum b6b_res b6b_chan_proc_chan(struct b6b_interp *interp,
+                                       struct b6b_obj *args)
+{
+	struct b6b_obj *n, *o;
+	struct b6b_chan *ch;
+	size_t cap = 0;
+	unsigned int argc;
+
+	argc = b6b_proc_get_args(interp, args, "o|i", NULL, &n);
+	if (!argc)
+		return B6B_ERR;
+
+	if (argc == 2) {
+		if ((n->i <= 0) || (n->i > (SIZE_MAX / sizeof(struct b6b_obj *))))
+			return B6B_ERR;
+
+		cap = (size_t)n->i;
+	}
+
+	ch = (struct b6b_chan *)malloc(sizeof(*ch));
+	if (!b6b_allocated(ch))
+		return B6B_ERR;
+
+	/* a bounded channel never grows */
+	ch->size = cap ? cap : B6B_CHAN_MIN;
+	ch->items = (struct b6b_obj **)malloc(sizeof(struct b6b_obj *) * ch->size);
+	if (!b6b_allocated(ch->items)) {
+		free(ch);
+		return B6B_ERR;
+	}
+
+	ch->head = 0;
+	ch->len = 0;
+	ch->cap = cap;
+	b6b_waitq_init(&ch->recvq);
+	b6b_waitq_init(&ch->sendq);
+	ch->closed = 0;
+
+	o = b6b_str_fmt("chan:%"PRIxPTR, (uintptr_t)ch);
+	if (b6b_unlikely(!o)) {
+		b6b_chan_del(ch);
+		return B6B_ERR;
+	}
+
+	o->priv = ch;
+	o->proc = b6b_chan_proc;
+	o->del = b6b_chan_del;
+
+	return b6b_return(interp, o);
+}
+
+static enum b6b_res b6b_chan_proc_select(struct b6b_interp *interp,
+                                         struct b6b_obj *args)
+{
+	struct b6b_litem *first, *li;
+	struct b6b_waiter *ws;
+	struct b6b_chan *ch;
+	struct b6b_obj *o, *l;
+	unsigned int n, i;
+	int ok;
+
+	if (!b6b_proc_get_args(interp, args, "o*", NULL, &first))
+		return B6B_ERR;
+
+	for (n = 0, li = first; li; li = b6b_list_next(li), ++n) {
+		if (!b6b_chan_get(li->o))
+			return B6B_ERR;
+	}
+
+	do {
+		/* receive from the first channel that isn't empty; fail only if all
+		 * channels are closed and drained */
+		ok = 0;
+		for (li = first; li; li = b6b_list_next(li)) {
+			ch = (struct b6b_chan *)li->o->priv;
+			if (ch->len)
+				break;
+
+			if (!ch->closed)
+				ok = 1;
+		}
+
+		if (li)
+			break;
+
+		if (!ok)
+			return b6b_chan_closed(interp);
+
+		ws = (struct b6b_waiter *)malloc(sizeof(*ws) * n);
+		if (!b6b_allocated(ws))
+			return B6B_ERR;
+
+		for (i = 0, li = first; li; li = b6b_list_next(li), ++i)
+			b6b_waitq_add(&((struct b6b_chan *)li->o->priv)->recvq,
+			              &ws[i],
+			              interp->fg);
+
+		ok = b6b_block(interp);
+
+		for (i = 0, li = first; li; li = b6b_list_next(li), ++i)
+			b6b_waitq_del(&((struct b6b_chan *)li->o->priv)->recvq, &ws[i]);
+
+		free(ws);
+
+		if (!ok)
+			return B6B_ERR;
+	} while (1);
+
+	o = b6b_chan_pop(interp, ch);
+	l = b6b_list_build(li->o, o, NULL);
+	b6b_unref(o);
+	if (b6b_unlikely(!l))
+		return B6B_ERR;
+
+	return b6b_return(interp, l);
+}
+
+static const struct b6b_ext_obj b6b_chan[] = {
+	{
+		.name = "chan",
+		.type = B6B_TYPE_STR,
+		.val.s = "chan",
+		.proc = b6b_chan_proc_chan
+	},
+	{
+		.name = "chan.select",
+		.type = B6B_TYPE_STR,
+		.val.s = "chan.select",
+		.proc = b6b_chan_proc_select
+	}
+};
+__b6b_ext(b6b_chan);
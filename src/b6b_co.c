@@ -1,7 +1,7 @@
 /*
  * This file is part of b6b.
  *
- * Copyright 2017 Dima Krasner
+ * Copyright 2017, 2026 Dima Krasner
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -16,34 +16,113 @@
  * limitations under the License.
  */
 
+#include <stdlib.h>
+
 #include <b6b.h>
 
-#define B6B_CO_BODY \
-	"{$global _fco 1}\n" \
-	"{$global _cos {}}\n" \
-	"{$proc co {" \
-		"{$list.append $_cos $1}\n" \
-		"{$if $_fco {" \
-			"{$spawn {" \
-				"{$loop {" \
-					"{$if $_cos {" \
-						"{$try {" \
-							"{$call [$list.pop $_cos 0]}" \
-						"}}" \
-					"} {" \
-						"{$global _fco 1}\n" \
-						"{$return}" \
-					"}}" \
-				"}}" \
-			"}}\n" \
-			"{$global _fco 0}" \
-		"}}" \
-	"}}" \
+struct b6b_co {
+	/* pending coroutines */
+	struct b6b_obj *q;
+	int running;
+};
+
+static void b6b_co_routine(struct b6b_thread *t, void *arg)
+{
+	struct b6b_interp *interp = (struct b6b_interp *)arg;
+	struct b6b_co *co = (struct b6b_co *)t->fn->priv;
+	struct b6b_obj *o;
+	enum b6b_res res;
+
+	/* call each coroutine in a new frame, like call does, and ignore
+	 * errors, unless the interpreter is exiting */
+	while (!b6b_list_empty(co->q)) {
+		o = b6b_list_pop(co->q, b6b_list_first(co->q));
+
+		if (b6b_unlikely(!b6b_frame_push(interp))) {
+			b6b_unref(o);
+			break;
+		}
+
+		res = b6b_call(interp, o);
+		b6b_frame_pop(interp);
+		b6b_unref(o);
+
+		if (res == B6B_EXIT)
+			break;
+	}
+
+	co->running = 0;
+	b6b_stop(interp);
+}
+
+static enum b6b_res b6b_co_proc(struct b6b_interp *interp,
+                                struct b6b_obj *args)
+{
+	struct b6b_obj *o, *stmts;
+	struct b6b_co *co;
+
+	if (!b6b_proc_get_args(interp, args, "oo", &o, &stmts) ||
+	    !b6b_as_list(stmts))
+		return B6B_ERR;
+
+	co = (struct b6b_co *)o->priv;
+	if (b6b_unlikely(!b6b_list_add(co->q, stmts)))
+		return B6B_ERR;
+
+	/* if there's no thread that calls queued coroutines, start one */
+	if (!co->running) {
+		if (!b6b_start_thread(interp, b6b_co_routine, o, 0, 0)) {
+			b6b_unref(b6b_list_pop(co->q, NULL));
+			return B6B_ERR;
+		}
+
+		co->running = 1;
+	}
+
+	return B6B_OK;
+}
+
+static void b6b_co_del(void *priv)
+{
+	struct b6b_co *co = (struct b6b_co *)priv;
+
+	b6b_unref(co->q);
+	free(co);
+}
 
 static int b6b_co_init(struct b6b_interp *interp)
 {
-	return b6b_call_copy(interp,
-	                     B6B_CO_BODY,
-	                     sizeof(B6B_CO_BODY) - 1) == B6B_OK;
+	struct b6b_obj *o;
+	struct b6b_co *co;
+
+	co = (struct b6b_co *)malloc(sizeof(*co));
+	if (!b6b_allocated(co))
+		return 0;
+
+	co->q = b6b_list_new();
+	if (b6b_unlikely(!co->q)) {
+		free(co);
+		return 0;
+	}
+
+	co->running = 0;
+
+	o = b6b_str_copy("co", 2);
+	if (b6b_unlikely(!o)) {
+		b6b_co_del(co);
+		return 0;
+	}
+
+	o->priv = co;
+	o->del = b6b_co_del;
+	o->proc = b6b_co_proc;
+
+	if (b6b_unlikely(!b6b_global(interp, o, o))) {
+		b6b_destroy(o);
+		return 0;
+	}
+
+	b6b_unref(o);
+	return 1;
 }
 __b6b_init(b6b_co_init);
@@ -17,6 +17,7 @@
  */
 
 #include <string.h>
+#include <limits.h>
 
 #include <b6b.h>
 
@@ -229,13 +230,45 @@ static enum b6b_res b6b_core_proc_call(struct b6b_interp *interp,
 static enum b6b_res b6b_core_proc_spawn(struct b6b_interp *interp,
                                         struct b6b_obj *args)
 {
-	struct b6b_obj *o;
+	struct b6b_obj *o, *stksiz, *prio, *f;
+	size_t sz = 0;
+	int p = 0;
+
+	switch (b6b_proc_get_args(interp,
+	                          args,
+	                          "oo|ii",
+	                          NULL,
+	                          &o,
+	                          &stksiz,
+	                          &prio)) {
+		case 4:
+			if ((prio->i < INT_MIN) || (prio->i > INT_MAX))
+				return B6B_ERR;
+
+			p = (int)prio->i;
+
+			/* fall through */
+		case 3:
+			/* 0 means the default stack size, so a priority can be specified
+			 * without one */
+			if (stksiz->i < 0)
+				return B6B_ERR;
 
-	if (b6b_proc_get_args(interp, args, "oo", NULL, &o) &&
-	    b6b_start(interp, o))
-		return B6B_OK;
+			sz = (size_t)stksiz->i;
 
-	return B6B_ERR;
+			/* fall through */
+		case 2:
+			break;
+
+		default:
+			return B6B_ERR;
+	}
+
+	f = b6b_spawn(interp, o, sz, p);
+	if (!f)
+		return B6B_ERR;
+
+	return b6b_return(interp, f);
 }
 
 #endif
@@ -1,7 +1,7 @@
 /*
  * This file is part of b6b.
  *
- * Copyright 2017, 2018 Dima Krasner
+ * Copyright 2017, 2018, 2020 Dima Krasner
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -16,128 +16,828 @@
  * limitations under the License.
  */
 
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/queue.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
 #include <b6b.h>
 
-#define B6B_EVLOOP_REMOVE \
-	"{$try {" \
-		"{$local fd [$2 fd]}\n" \
-		"{[$list.index $. 0] remove $fd}\n" \
-		"{$map d [$list.range $. 1 5] {" \
-			"{$dict.unset $d $fd}" \
-		"}}" \
-	"} {} {" \
-		"{$2 close}" \
-	"}}"
-
-#define B6B_EVLOOP_ADD \
-	"{$local fd [$2 fd]}\n" \
-	"{$dict.set [$list.index $. 1] $fd $2}\n" \
-	"{$dict.set [$list.index $. 2] $fd $3}\n" \
-	"{$dict.set [$list.index $. 3] $fd $4}\n" \
-	"{$dict.set [$list.index $. 4] $fd $5}\n" \
-	"{$if [$&& $3 $4] {" \
-		"{[$list.index $. 0] add $fd $POLLINOUT}" \
-	"} {" \
-		"{$if $3 {" \
-			"{[$list.index $. 0] add $fd $POLLIN}" \
-		"} {" \
-			"{[$list.index $. 0] add $fd $POLLOUT}" \
-		"}}" \
-	"}}"
-
-#define B6B_EVLOOP_UPDATE \
-	"{[$list.index $. 0] remove [$2 fd]}\n" \
-	"{$0 add $2 $3 $4 $5}"
-
-#define B6B_EVLOOP_AFTER \
-	"{$0 add [$timer $2] [$proc _ {" \
-		"{$call $.}\n" \
-		"{$throw}" \
-	"} [$list.new [$list.new $3]]] {} {}}"
-
-#define B6B_EVLOOP_EVERY \
-	"{$0 add [$timer $2] [$proc _ {" \
-		"{$1 read}\n" \
-		"{$call $.}" \
-	"} [$list.new [$list.new $3]]] {} {}}"
-
-#define B6B_EVLOOP_WAIT \
-	"{$loop {" \
-		"{$map {p strms inps outps errps} $. {" \
-			"{$local n [$list.len $strms]}\n" \
-			"{$if [$== $n 0] {" \
-				"{$return}" \
-			"}}\n" \
-			"{$map {rfds wfds efds} [$p wait [$* $n 1.5] $2] {" \
-				"{$map fd $efds {" \
-					"{$local strm [$dict.get $strms $fd {}]}\n" \
-					"{$if $strm {" \
-						"{$try {" \
-							"{[$dict.get $errps $fd] $strm}" \
-						"} {} {" \
-							"{$0 remove $strm}" \
-						"}}" \
-					"}}" \
-				"}}\n" \
-				"{$map fd $wfds {" \
-					"{$local strm [$dict.get $strms $fd {}]}\n" \
-					"{$if $strm {" \
-						"{$try {" \
-							"{[$dict.get $outps $fd] $strm}" \
-						"} {" \
-							"{$0 remove $strm}" \
-						"}}" \
-					"}}" \
-				"}}\n" \
-				"{$map fd $rfds {" \
-					"{$local strm [$dict.get $strms $fd {}]}\n" \
-					"{$if $strm {" \
-						"{$try {" \
-							"{[$dict.get $inps $fd] $strm}" \
-						"} {" \
-							"{$0 remove $strm}" \
-						"}}" \
-					"}}" \
-				"}}" \
-			"}}" \
-		"}}" \
-	"}}"
-
-#define B6B_EVLOOP_BODY \
-	"{$proc evloop {" \
-		"{$proc _ {" \
-			"{$if [$== $1 remove] {" \
-				B6B_EVLOOP_REMOVE \
-			"} {" \
-				"{$if [$== $1 add] {" \
-					B6B_EVLOOP_ADD \
-				"} {" \
-					"{$if [$== $1 update] {" \
-						B6B_EVLOOP_UPDATE \
-					"} {" \
-						"{$if [$== $1 after] {" \
-							B6B_EVLOOP_AFTER \
-						"} {" \
-							"{$if [$== $1 every] {" \
-								B6B_EVLOOP_EVERY \
-							"} {" \
-								"{$if [$== $1 wait] {" \
-									B6B_EVLOOP_WAIT \
-								"} {" \
-									"{$throw {bad evloop op}}" \
-								"}}" \
-							"}}" \
-						"}}" \
-					"}}" \
-				"}}" \
-			"}}" \
-		"} [$list.new [$poll] {} {} {} {}]}" \
-	"}}"
-
-static int b6b_evloop_init(struct b6b_interp *interp)
-{
-	return b6b_call_copy(interp,
-	                     B6B_EVLOOP_BODY,
-	                     sizeof(B6B_EVLOOP_BODY) - 1) == B6B_OK;
-}
-__b6b_init(b6b_evloop_init);
+/* timers are rounded up to the next tick, so timers that expire at about the
+ * same time fire together */
+#define B6B_EVLOOP_TICK 10000000 /* ns */
+
+/* the timer wheel has four levels of 64 slots each: a slot at level n holds
+ * the timers that expire within 64^(n + 1) ticks, and its timers are moved to
+ * a lower level once their time is close */
+#define B6B_EVLOOP_LVL_BITS 6
+#define B6B_EVLOOP_LVL_SIZE (1 << B6B_EVLOOP_LVL_BITS)
+#define B6B_EVLOOP_LVL_MASK (B6B_EVLOOP_LVL_SIZE - 1)
+#define B6B_EVLOOP_LVLS 4
+#define B6B_EVLOOP_MAX_DELTA \
+	((uint64_t)1 << (B6B_EVLOOP_LVL_BITS * B6B_EVLOOP_LVLS))
+
+struct b6b_evloop_src {
+	struct b6b_obj *strm;
+	struct b6b_obj *inp;
+	struct b6b_obj *outp;
+	struct b6b_obj *errp;
+};
+
+struct b6b_evloop;
+
+TAILQ_HEAD(b6b_evloop_timers, b6b_evloop_timer);
+struct b6b_evloop_timer {
+	TAILQ_ENTRY(b6b_evloop_timer) ents;
+	/* the list that holds the timer, or NULL if it's not pending */
+	struct b6b_evloop_timers *head;
+	struct b6b_evloop *loop;
+	/* the handle, which owns the timer */
+	struct b6b_obj *o;
+	struct b6b_obj *cb;
+	uint64_t expires;
+	/* in ticks, or 0 if the timer fires once */
+	uint64_t interval;
+};
+
+struct b6b_evloop {
+	/* registered streams, indexed by file descriptor */
+	struct b6b_evloop_src *srcs;
+	struct epoll_event *evs;
+	struct b6b_evloop_timers wheel[B6B_EVLOOP_LVLS][B6B_EVLOOP_LVL_SIZE];
+	/* timers that expired but weren't called yet */
+	struct b6b_evloop_timers expired;
+	/* non-empty slots, per level */
+	uint64_t bits[B6B_EVLOOP_LVLS];
+	/* the last tick processed */
+	uint64_t now;
+	/* the tick the timerfd is armed for, or 0 */
+	uint64_t armed;
+	size_t nsrcs;
+	size_t nevs;
+	size_t n;
+	size_t ntimers;
+	int fd;
+	int tfd;
+	int waiting;
+};
+
+static void b6b_evloop_link(struct b6b_evloop *loop,
+                            struct b6b_evloop_timer *t)
+{
+	uint64_t delta, expires = t->expires;
+	int lvl, i;
+
+	delta = (expires > loop->now) ? expires - loop->now : 0;
+
+	/* timers that expire later than the top level can hold are moved down
+	 * when their slot is reached, then placed at the top level again */
+	if (delta >= B6B_EVLOOP_MAX_DELTA) {
+		expires = loop->now + B6B_EVLOOP_MAX_DELTA - 1;
+		lvl = B6B_EVLOOP_LVLS - 1;
+	} else {
+		for (lvl = 0;
+		     (lvl < B6B_EVLOOP_LVLS - 1) &&
+		     (delta >= ((uint64_t)1 << (B6B_EVLOOP_LVL_BITS * (lvl + 1))));
+		     ++lvl);
+	}
+
+	i = (int)((expires >> (B6B_EVLOOP_LVL_BITS * lvl)) & B6B_EVLOOP_LVL_MASK);
+	t->head = &loop->wheel[lvl][i];
+	TAILQ_INSERT_TAIL(t->head, t, ents);
+	loop->bits[lvl] |= (uint64_t)1 << i;
+}
+
+static void b6b_evloop_unlink(struct b6b_evloop *loop,
+                              struct b6b_evloop_timer *t)
+{
+	ptrdiff_t i;
+
+	TAILQ_REMOVE(t->head, t, ents);
+
+	if ((t->head != &loop->expired) && TAILQ_EMPTY(t->head)) {
+		i = t->head - &loop->wheel[0][0];
+		loop->bits[i / B6B_EVLOOP_LVL_SIZE] &= ~((uint64_t)1 <<
+		                                       (i % B6B_EVLOOP_LVL_SIZE));
+	}
+
+	t->head = NULL;
+}
+
+/* returns the next tick when timers expire or move to a lower level, or 0 */
+static uint64_t b6b_evloop_next(const struct b6b_evloop *loop)
+{
+	uint64_t next = 0, u, rot, tick;
+	int lvl, shift, r;
+
+	for (lvl = 0; lvl < B6B_EVLOOP_LVLS; ++lvl) {
+		if (!loop->bits[lvl])
+			continue;
+
+		/* find the first non-empty slot, starting from the next one */
+		shift = B6B_EVLOOP_LVL_BITS * lvl;
+		u = (loop->now >> shift) + 1;
+		r = (int)(u & B6B_EVLOOP_LVL_MASK);
+		rot = loop->bits[lvl] >> r;
+		if (r)
+			rot |= loop->bits[lvl] << (B6B_EVLOOP_LVL_SIZE - r);
+
+		tick = (u + (uint64_t)__builtin_ctzll(rot)) << shift;
+		if (!next || (tick < next))
+			next = tick;
+	}
+
+	return next;
+}
+
+/* arms the timerfd for the next tick that requires processing */
+static int b6b_evloop_arm(struct b6b_evloop *loop)
+{
+	struct itimerspec its = {{0}};
+	uint64_t next;
+
+	if (!TAILQ_EMPTY(&loop->expired))
+		next = loop->now;
+	else
+		next = b6b_evloop_next(loop);
+
+	if (next == loop->armed)
+		return 1;
+
+	if (next) {
+		its.it_value.tv_sec = (time_t)(next / (1000000000 / B6B_EVLOOP_TICK));
+		its.it_value.tv_nsec =
+		          (long)(next % (1000000000 / B6B_EVLOOP_TICK)) * B6B_EVLOOP_TICK;
+	}
+
+	if (timerfd_settime(loop->tfd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+		return 0;
+
+	loop->armed = next;
+	return 1;
+}
+
+/* stops a timer: if nothing else references its handle, the timer is freed */
+static void b6b_evloop_cancel(struct b6b_evloop_timer *t)
+{
+	struct b6b_evloop *loop = t->loop;
+
+	if (!loop)
+		return;
+
+	if (t->head)
+		b6b_evloop_unlink(loop, t);
+
+	t->loop = NULL;
+	--loop->ntimers;
+	b6b_unref(t->o);
+}
+
+/* calls a timer and unregisters it if it fails */
+static enum b6b_res b6b_evloop_fire(struct b6b_interp *interp,
+                                    struct b6b_evloop *loop,
+                                    struct b6b_evloop_timer *t)
+{
+	struct b6b_obj *o = t->o;
+	enum b6b_res res;
+
+	/* the callback may cancel the timer */
+	b6b_ref(o);
+
+	if (t->interval) {
+		t->expires += t->interval;
+		if (t->expires <= loop->now)
+			t->expires = loop->now + t->interval;
+
+		b6b_evloop_link(loop, t);
+	} else
+		b6b_evloop_cancel(t);
+
+	res = b6b_call_proc(interp, t->cb, NULL);
+
+	/* ignore errors unless errors should propagate */
+	if (res == B6B_ERR) {
+		b6b_evloop_cancel(t);
+
+		if (!(interp->opts & B6B_OPT_RAISE))
+			res = B6B_OK;
+	} else if (res != B6B_EXIT)
+		res = B6B_OK;
+
+	b6b_unref(o);
+	return res;
+}
+
+/* moves all timers in a slot to lower levels */
+static void b6b_evloop_cascade(struct b6b_evloop *loop,
+                               const int lvl,
+                               const int i)
+{
+	struct b6b_evloop_timers ts;
+	struct b6b_evloop_timer *t;
+
+	TAILQ_INIT(&ts);
+	TAILQ_CONCAT(&ts, &loop->wheel[lvl][i], ents);
+	loop->bits[lvl] &= ~((uint64_t)1 << i);
+
+	while ((t = TAILQ_FIRST(&ts))) {
+		TAILQ_REMOVE(&ts, t, ents);
+		b6b_evloop_link(loop, t);
+	}
+}
+
+/* calls all timers that expire until a given tick */
+static enum b6b_res b6b_evloop_expire(struct b6b_interp *interp,
+                                      struct b6b_evloop *loop,
+                                      const uint64_t tick)
+{
+	struct b6b_evloop_timer *t;
+	uint64_t next;
+	enum b6b_res res;
+	int lvl, i;
+
+	do {
+		/* a previous call may have stopped after an error */
+		while ((t = TAILQ_FIRST(&loop->expired))) {
+			b6b_evloop_unlink(loop, t);
+
+			res = b6b_evloop_fire(interp, loop, t);
+			if (res != B6B_OK)
+				return res;
+		}
+
+		next = b6b_evloop_next(loop);
+		if (!next || (next > tick))
+			break;
+
+		loop->now = next;
+
+		/* start from the top, since timers may move down more than one
+		 * level */
+		for (lvl = B6B_EVLOOP_LVLS - 1; lvl > 0; --lvl) {
+			if (next & (((uint64_t)1 << (B6B_EVLOOP_LVL_BITS * lvl)) - 1))
+				continue;
+
+			i = (int)((next >> (B6B_EVLOOP_LVL_BITS * lvl)) &
+			          B6B_EVLOOP_LVL_MASK);
+			if (loop->bits[lvl] & ((uint64_t)1 << i))
+				b6b_evloop_cascade(loop, lvl, i);
+		}
+
+		i = (int)(next & B6B_EVLOOP_LVL_MASK);
+		if (loop->bits[0] & ((uint64_t)1 << i)) {
+			TAILQ_CONCAT(&loop->expired, &loop->wheel[0][i], ents);
+			loop->bits[0] &= ~((uint64_t)1 << i);
+
+			TAILQ_FOREACH(t, &loop->expired, ents)
+				t->head = &loop->expired;
+		}
+	} while (1);
+
+	if (loop->now < tick)
+		loop->now = tick;
+
+	return B6B_OK;
+}
+
+static enum b6b_res b6b_evloop_timer_proc(struct b6b_interp *interp,
+                                          struct b6b_obj *args)
+{
+	struct b6b_obj *o, *op;
+
+	if (!b6b_proc_get_args(interp, args, "os", &o, &op))
+		return B6B_ERR;
+
+	if (strcmp(op->s, "cancel") == 0) {
+		b6b_evloop_cancel((struct b6b_evloop_timer *)o->priv);
+		return B6B_OK;
+	}
+
+	b6b_return_fmt(interp, "bad timer op: %s", op->s);
+	return B6B_ERR;
+}
+
+static void b6b_evloop_timer_del(void *priv)
+{
+	struct b6b_evloop_timer *t = (struct b6b_evloop_timer *)priv;
+
+	b6b_unref(t->cb);
+	free(t);
+}
+
+static enum b6b_res b6b_evloop_timer(struct b6b_interp *interp,
+                                     struct b6b_evloop *loop,
+                                     struct b6b_obj *f,
+                                     struct b6b_obj *cb,
+                                     const int every)
+{
+	struct epoll_event ev = {0};
+	struct b6b_evloop_timer *t;
+	b6b_float ns;
+	uint64_t now;
+
+	if (!b6b_as_float(f) || (f->f <= 0))
+		return B6B_ERR;
+
+	ns = ceil(f->f * 1000000000);
+	if (ns >= (b6b_float)B6B_EVLOOP_MAX_DELTA * B6B_EVLOOP_MAX_DELTA)
+		return B6B_ERR;
+
+	if (loop->tfd < 0) {
+		loop->tfd = timerfd_create(CLOCK_MONOTONIC,
+		                           TFD_NONBLOCK | TFD_CLOEXEC);
+		if (loop->tfd < 0)
+			return b6b_return_strerror(interp, errno);
+
+		ev.events = EPOLLIN;
+		ev.data.fd = loop->tfd;
+		if (epoll_ctl(loop->fd, EPOLL_CTL_ADD, loop->tfd, &ev) < 0) {
+			close(loop->tfd);
+			loop->tfd = -1;
+			return b6b_return_strerror(interp, errno);
+		}
+	}
+
+	t = (struct b6b_evloop_timer *)malloc(sizeof(*t));
+	if (!b6b_allocated(t))
+		return B6B_ERR;
+
+	t->o = b6b_str_fmt("timer:%"PRIxPTR, (uintptr_t)t);
+	if (b6b_unlikely(!t->o)) {
+		free(t);
+		return B6B_ERR;
+	}
+
+	/* if there are no timers, nothing needs to be processed until now */
+	now = b6b_now();
+	if (!loop->ntimers)
+		loop->now = now / B6B_EVLOOP_TICK;
+
+	/* round up, so the timer never fires early */
+	t->loop = loop;
+	t->cb = b6b_ref(cb);
+	t->expires = (now + (uint64_t)ns + B6B_EVLOOP_TICK - 1) / B6B_EVLOOP_TICK;
+	t->interval = 0;
+	if (every)
+		t->interval = ((uint64_t)ns + B6B_EVLOOP_TICK - 1) / B6B_EVLOOP_TICK;
+	t->o->proc = b6b_evloop_timer_proc;
+	t->o->priv = t;
+	t->o->del = b6b_evloop_timer_del;
+
+	/* the loop holds a reference to the handle until the timer is done */
+	b6b_evloop_link(loop, t);
+	++loop->ntimers;
+
+	if (!b6b_evloop_arm(loop)) {
+		b6b_return_strerror(interp, errno);
+		b6b_evloop_cancel(t);
+		return B6B_ERR;
+	}
+
+	return b6b_return(interp, b6b_ref(t->o));
+}
+
+/* processes all expired timers */
+static enum b6b_res b6b_evloop_timers(struct b6b_interp *interp,
+                                      struct b6b_evloop *loop)
+{
+	uint64_t exp;
+	enum b6b_res res;
+
+	/* the timerfd is disarmed once it fires */
+	if ((read(loop->tfd, &exp, sizeof(exp)) < 0) && (errno != EAGAIN))
+		return b6b_return_strerror(interp, errno);
+
+	loop->armed = 0;
+
+	res = b6b_evloop_expire(interp, loop, b6b_now() / B6B_EVLOOP_TICK);
+
+	if (!b6b_evloop_arm(loop))
+		return b6b_return_strerror(interp, errno);
+
+	return res;
+}
+
+static void b6b_evloop_src_free(struct b6b_evloop_src *src)
+{
+	b6b_unref(src->strm);
+	b6b_unref(src->inp);
+	b6b_unref(src->outp);
+	b6b_unref(src->errp);
+	src->strm = NULL;
+}
+
+/* unregisters a stream, then closes it */
+static void b6b_evloop_drop(struct b6b_evloop *loop, const int fd)
+{
+	struct b6b_evloop_src *src = &loop->srcs[fd];
+	struct b6b_obj *strm = src->strm;
+
+	epoll_ctl(loop->fd, EPOLL_CTL_DEL, fd, NULL);
+
+	/* the stream may outlive the event loop, so it's closed explicitly */
+	b6b_ref(strm);
+	b6b_evloop_src_free(src);
+	--loop->n;
+
+	b6b_strm_obj_close(strm);
+	b6b_unref(strm);
+}
+
+static enum b6b_res b6b_evloop_set(struct b6b_interp *interp,
+                                   struct b6b_evloop *loop,
+                                   struct b6b_obj *strm,
+                                   struct b6b_obj *inp,
+                                   struct b6b_obj *outp,
+                                   struct b6b_obj *errp)
+{
+	struct epoll_event ev = {0};
+	struct b6b_evloop_src *srcs, *src;
+	size_t nsrcs;
+	int fd, op = EPOLL_CTL_ADD;
+
+	fd = b6b_strm_obj_fd(strm);
+	if (fd < 0)
+		return B6B_ERR;
+
+	if ((size_t)fd >= loop->nsrcs) {
+		nsrcs = loop->nsrcs ? loop->nsrcs : 64;
+		while (nsrcs <= (size_t)fd)
+			nsrcs *= 2;
+
+		srcs = (struct b6b_evloop_src *)realloc(loop->srcs,
+		                                        sizeof(*srcs) * nsrcs);
+		if (!b6b_allocated(srcs))
+			return B6B_ERR;
+
+		memset(&srcs[loop->nsrcs],
+		       0,
+		       sizeof(*srcs) * (nsrcs - loop->nsrcs));
+		loop->srcs = srcs;
+		loop->nsrcs = nsrcs;
+	}
+
+	src = &loop->srcs[fd];
+	if (src->strm)
+		op = EPOLL_CTL_MOD;
+
+	if (b6b_obj_istrue(inp) && b6b_obj_istrue(outp))
+		ev.events = EPOLLIN | EPOLLOUT;
+	else if (b6b_obj_istrue(inp))
+		ev.events = EPOLLIN;
+	else
+		ev.events = EPOLLOUT;
+	ev.data.fd = fd;
+
+	if ((epoll_ctl(loop->fd, op, fd, &ev) < 0) &&
+	    ((op == EPOLL_CTL_ADD) ||
+	     (errno != ENOENT) ||
+	     (epoll_ctl(loop->fd, EPOLL_CTL_ADD, fd, &ev) < 0)))
+		return b6b_return_strerror(interp, errno);
+
+	b6b_ref(strm);
+	b6b_ref(inp);
+	b6b_ref(outp);
+	b6b_ref(errp);
+
+	if (src->strm)
+		b6b_evloop_src_free(src);
+	else
+		++loop->n;
+
+	src->strm = strm;
+	src->inp = inp;
+	src->outp = outp;
+	src->errp = errp;
+	return B6B_OK;
+}
+
+static enum b6b_res b6b_evloop_remove(struct b6b_evloop *loop,
+                                      struct b6b_obj *strm)
+{
+	size_t i;
+	int fd;
+
+	/* timer handles can be removed like streams */
+	if (strm->proc == b6b_evloop_timer_proc) {
+		b6b_evloop_cancel((struct b6b_evloop_timer *)strm->priv);
+		return B6B_OK;
+	}
+
+	fd = b6b_strm_obj_fd(strm);
+	if ((fd >= 0) &&
+	    ((size_t)fd < loop->nsrcs) &&
+	    (loop->srcs[fd].strm == strm)) {
+		b6b_evloop_drop(loop, fd);
+		return B6B_OK;
+	}
+
+	/* if the stream is closed, we don't know its file descriptor */
+	for (i = 0; i < loop->nsrcs; ++i) {
+		if (loop->srcs[i].strm == strm) {
+			b6b_evloop_drop(loop, (int)i);
+			return B6B_OK;
+		}
+	}
+
+	b6b_strm_obj_close(strm);
+	return B6B_OK;
+}
+
+/* calls a handler and unregisters the stream if the handler fails */
+static enum b6b_res b6b_evloop_call(struct b6b_interp *interp,
+                                    struct b6b_evloop *loop,
+                                    const int fd,
+                                    const uint32_t events)
+{
+	struct b6b_evloop_src src = loop->srcs[fd];
+	enum b6b_res res = B6B_OK;
+
+	/* the handler may unregister the stream */
+	b6b_ref(src.strm);
+	b6b_ref(src.inp);
+	b6b_ref(src.outp);
+	b6b_ref(src.errp);
+
+	if (events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+		res = b6b_call_proc(interp, src.errp, src.strm, NULL);
+		if (loop->srcs[fd].strm == src.strm)
+			b6b_evloop_drop(loop, fd);
+	} else {
+		if (events & EPOLLOUT)
+			res = b6b_call_proc(interp, src.outp, src.strm, NULL);
+
+		if ((res == B6B_OK) &&
+		    (events & EPOLLIN) &&
+		    (loop->srcs[fd].strm == src.strm))
+			res = b6b_call_proc(interp, src.inp, src.strm, NULL);
+	}
+
+	/* ignore errors unless errors should propagate */
+	if (res == B6B_ERR) {
+		if (loop->srcs[fd].strm == src.strm)
+			b6b_evloop_drop(loop, fd);
+
+		if (!(interp->opts & B6B_OPT_RAISE))
+			res = B6B_OK;
+	} else if (res != B6B_EXIT)
+		res = B6B_OK;
+
+	b6b_unref(src.errp);
+	b6b_unref(src.outp);
+	b6b_unref(src.inp);
+	b6b_unref(src.strm);
+	return res;
+}
+
+static enum b6b_res b6b_evloop_wait(struct b6b_interp *interp,
+                                    struct b6b_evloop *loop,
+                                    struct b6b_obj *t)
+{
+	struct epoll_event *evs;
+	size_t nevs;
+	enum b6b_res res;
+	int i, ret, fd, timeout;
+
+	if (!b6b_as_int(t) || (t->i < INT_MIN) || (t->i > INT_MAX))
+		return B6B_ERR;
+
+	/* t may lose its integer representation during context switch */
+	timeout = (int)t->i;
+
+	/* the event buffer is reused by the next wait */
+	if (loop->waiting)
+		return B6B_ERR;
+
+	/* wait until all streams and timers are unregistered */
+	while (loop->n || loop->ntimers) {
+		/* leave room for more events than streams, since each stream can
+		 * have multiple events, and for the timerfd */
+		nevs = loop->n + loop->n / 2 + 1;
+		if (nevs > INT_MAX)
+			nevs = INT_MAX;
+
+		if (nevs > loop->nevs) {
+			evs = (struct epoll_event *)realloc(loop->evs,
+			                                    sizeof(*evs) * nevs);
+			if (!b6b_allocated(evs))
+				return B6B_ERR;
+
+			loop->evs = evs;
+			loop->nevs = nevs;
+		}
+
+		loop->waiting = 1;
+		if (!b6b_epoll_wait(interp,
+		                    loop->fd,
+		                    loop->evs,
+		                    (int)nevs,
+		                    timeout,
+		                    &ret)) {
+			loop->waiting = 0;
+			return B6B_ERR;
+		}
+
+		if (ret < 0) {
+			loop->waiting = 0;
+			if (errno == EINTR)
+				continue;
+
+			return b6b_return_strerror(interp, errno);
+		}
+
+		for (i = 0; i < ret; ++i) {
+			fd = loop->evs[i].data.fd;
+
+			if (fd == loop->tfd)
+				res = b6b_evloop_timers(interp, loop);
+			/* a previous handler may have unregistered the stream */
+			else if (((size_t)fd >= loop->nsrcs) || !loop->srcs[fd].strm)
+				continue;
+			else
+				res = b6b_evloop_call(interp,
+				                      loop,
+				                      fd,
+				                      loop->evs[i].events);
+
+			if (res != B6B_OK) {
+				loop->waiting = 0;
+				return res;
+			}
+		}
+
+		loop->waiting = 0;
+	}
+
+	return B6B_OK;
+}
+
+static enum b6b_res b6b_evloop_proc(struct b6b_interp *interp,
+                                    struct b6b_obj *args)
+{
+	struct b6b_obj *o, *op, *a, *b, *c, *d;
+	struct b6b_evloop *loop;
+	enum b6b_res res = B6B_ERR;
+	unsigned int argc;
+
+	argc = b6b_proc_get_args(interp,
+	                         args,
+	                         "os|oooo",
+	                         &o,
+	                         &op,
+	                         &a,
+	                         &b,
+	                         &c,
+	                         &d);
+	if (!argc)
+		return B6B_ERR;
+
+	loop = (struct b6b_evloop *)o->priv;
+
+	/* a handler may free the event loop */
+	b6b_ref(o);
+
+	switch (argc) {
+		case 3:
+			if (strcmp(op->s, "remove") == 0)
+				res = b6b_evloop_remove(loop, a);
+			else if (strcmp(op->s, "wait") == 0)
+				res = b6b_evloop_wait(interp, loop, a);
+			else
+				goto bad;
+
+			break;
+
+		case 4:
+			if (strcmp(op->s, "after") == 0)
+				res = b6b_evloop_timer(interp, loop, a, b, 0);
+			else if (strcmp(op->s, "every") == 0)
+				res = b6b_evloop_timer(interp, loop, a, b, 1);
+			else
+				goto bad;
+
+			break;
+
+		case 6:
+			if ((strcmp(op->s, "add") == 0) || (strcmp(op->s, "update") == 0))
+				res = b6b_evloop_set(interp, loop, a, b, c, d);
+			else
+				goto bad;
+
+			break;
+
+		default:
+			goto bad;
+	}
+
+	b6b_unref(o);
+	return res;
+
+bad:
+	b6b_unref(o);
+	b6b_return_fmt(interp, "bad evloop op: %s", op->s);
+	return B6B_ERR;
+}
+
+static void b6b_evloop_del(void *priv)
+{
+	struct b6b_evloop *loop = (struct b6b_evloop *)priv;
+	struct b6b_evloop_timer *t;
+	size_t i;
+	int lvl;
+
+	for (i = 0; i < loop->nsrcs; ++i) {
+		if (loop->srcs[i].strm)
+			b6b_evloop_src_free(&loop->srcs[i]);
+	}
+
+	/* timer handles may outlive the event loop */
+	for (lvl = 0; lvl < B6B_EVLOOP_LVLS; ++lvl) {
+		for (i = 0; i < B6B_EVLOOP_LVL_SIZE; ++i) {
+			while ((t = TAILQ_FIRST(&loop->wheel[lvl][i])))
+				b6b_evloop_cancel(t);
+		}
+	}
+
+	while ((t = TAILQ_FIRST(&loop->expired)))
+		b6b_evloop_cancel(t);
+
+	if (loop->tfd >= 0)
+		close(loop->tfd);
+
+	close(loop->fd);
+	free(loop->evs);
+	free(loop->srcs);
+	free(loop);
+}
+
+static enum b6b_res b6b_evloop_proc_evloop(struct b6b_interp *interp,
+                                           struct b6b_obj *args)
+{
+	struct b6b_evloop *loop;
+	struct b6b_obj *o;
+	int lvl, i;
+
+	if (!b6b_proc_get_args(interp, args, "o", NULL))
+		return B6B_ERR;
+
+	loop = (struct b6b_evloop *)malloc(sizeof(*loop));
+	if (!b6b_allocated(loop))
+		return B6B_ERR;
+
+	loop->fd = epoll_create1(EPOLL_CLOEXEC);
+	if (loop->fd < 0) {
+		free(loop);
+		return b6b_return_strerror(interp, errno);
+	}
+
+	o = b6b_str_fmt("evloop:%d", loop->fd);
+	if (b6b_unlikely(!o)) {
+		close(loop->fd);
+		free(loop);
+		return B6B_ERR;
+	}
+
+	for (lvl = 0; lvl < B6B_EVLOOP_LVLS; ++lvl) {
+		for (i = 0; i < B6B_EVLOOP_LVL_SIZE; ++i)
+			TAILQ_INIT(&loop->wheel[lvl][i]);
+
+		loop->bits[lvl] = 0;
+	}
+
+	TAILQ_INIT(&loop->expired);
+	loop->srcs = NULL;
+	loop->evs = NULL;
+	loop->now = 0;
+	loop->armed = 0;
+	loop->nsrcs = 0;
+	loop->nevs = 0;
+	loop->n = 0;
+	loop->ntimers = 0;
+	loop->tfd = -1;
+	loop->waiting = 0;
+
+	o->proc = b6b_evloop_proc;
+	o->priv = loop;
+	o->del = b6b_evloop_del;
+
+	return b6b_return(interp, o);
+}
+
+static const struct b6b_ext_obj b6b_evloop[] = {
+	{
+		.name = "evloop",
+		.type = B6B_TYPE_STR,
+		.val.s = "evloop",
+		.proc = b6b_evloop_proc_evloop
+	}
+};
+__b6b_ext(b6b_evloop);
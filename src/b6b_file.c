@@ -21,12 +21,17 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <limits.h>
 
 #include <b6b.h>
 
+#define B6B_FILE_OPEN_TIMEOUT (30 * (uint64_t)1000000000)
+
 struct b6b_file_mode {
 	const char *mode;
 	const char *fmode;
+	/* the open() flags equivalent to fmode */
+	int flags;
 	const struct b6b_strm_ops *ops;
 	int bmode;
 };
@@ -53,29 +58,29 @@ static const struct b6b_strm_ops b6b_rw_file_ops = {
 };
 
 static const struct b6b_file_mode b6b_file_modes[] = {
-	{"r", "r", &b6b_ro_file_ops, _IOLBF},
-	{"w", "w", &b6b_wo_file_ops, _IOLBF},
-	{"a", "a", &b6b_wo_file_ops, _IOLBF},
+	{"r", "r", O_RDONLY, &b6b_ro_file_ops, _IOLBF},
+	{"w", "w", O_WRONLY | O_CREAT | O_TRUNC, &b6b_wo_file_ops, _IOLBF},
+	{"a", "a", O_WRONLY | O_CREAT | O_APPEND, &b6b_wo_file_ops, _IOLBF},
 
-	{"rb", "r", &b6b_ro_file_ops, _IOFBF},
-	{"wb", "w", &b6b_wo_file_ops, _IOFBF},
-	{"ab", "a", &b6b_wo_file_ops, _IOFBF},
+	{"rb", "r", O_RDONLY, &b6b_ro_file_ops, _IOFBF},
+	{"wb", "w", O_WRONLY | O_CREAT | O_TRUNC, &b6b_wo_file_ops, _IOFBF},
+	{"ab", "a", O_WRONLY | O_CREAT | O_APPEND, &b6b_wo_file_ops, _IOFBF},
 
-	{"ru", "r", &b6b_ro_file_ops, _IONBF},
-	{"wu", "w", &b6b_wo_file_ops, _IONBF},
-	{"au", "a", &b6b_wo_file_ops, _IONBF},
+	{"ru", "r", O_RDONLY, &b6b_ro_file_ops, _IONBF},
+	{"wu", "w", O_WRONLY | O_CREAT | O_TRUNC, &b6b_wo_file_ops, _IONBF},
+	{"au", "a", O_WRONLY | O_CREAT | O_APPEND, &b6b_wo_file_ops, _IONBF},
 
-	{"r+", "r+", &b6b_rw_file_ops, _IOLBF},
-	{"w+", "w+", &b6b_rw_file_ops, _IOLBF},
-	{"a+", "a+", &b6b_rw_file_ops, _IOLBF},
+	{"r+", "r+", O_RDWR, &b6b_rw_file_ops, _IOLBF},
+	{"w+", "w+", O_RDWR | O_CREAT | O_TRUNC, &b6b_rw_file_ops, _IOLBF},
+	{"a+", "a+", O_RDWR | O_CREAT | O_APPEND, &b6b_rw_file_ops, _IOLBF},
 
-	{"r+b", "r+", &b6b_rw_file_ops, _IOFBF},
-	{"w+b", "w+", &b6b_rw_file_ops, _IOFBF},
-	{"a+b", "a+", &b6b_rw_file_ops, _IOFBF},
+	{"r+b", "r+", O_RDWR, &b6b_rw_file_ops, _IOFBF},
+	{"w+b", "w+", O_RDWR | O_CREAT | O_TRUNC, &b6b_rw_file_ops, _IOFBF},
+	{"a+b", "a+", O_RDWR | O_CREAT | O_APPEND, &b6b_rw_file_ops, _IOFBF},
 
-	{"r+u", "r+", &b6b_rw_file_ops, _IONBF},
-	{"w+u", "w+", &b6b_rw_file_ops, _IONBF},
-	{"a+u", "a+", &b6b_rw_file_ops, _IONBF}
+	{"r+u", "r+", O_RDWR, &b6b_rw_file_ops, _IONBF},
+	{"w+u", "w+", O_RDWR | O_CREAT | O_TRUNC, &b6b_rw_file_ops, _IONBF},
+	{"a+u", "a+", O_RDWR | O_CREAT | O_APPEND, &b6b_rw_file_ops, _IONBF}
 };
 
 #define b6b_file_def_mode b6b_file_modes[0]
@@ -150,19 +155,105 @@ static void b6b_file_do_fopen(void *arg)
 		data->rerrno = errno;
 }
 
+static void b6b_file_fopen_free(void *arg)
+{
+	struct b6b_file_fopen_data *data = (struct b6b_file_fopen_data *)arg;
+
+	/* if fopen() timed out but succeeded later, nobody uses the file */
+	if (data->fp)
+		fclose(data->fp);
+
+	free(data->path);
+	free(data);
+}
+
+static FILE *b6b_file_fopen(struct b6b_interp *interp,
+                            struct b6b_obj *path,
+                            const struct b6b_file_mode *fmode,
+                            const uint64_t timeout)
+{
+	struct b6b_file_fopen_data *data;
+	FILE *fp;
+	int err, fd;
+
+	/* the data must outlive this call if fopen() times out */
+	data = (struct b6b_file_fopen_data *)malloc(sizeof(*data));
+	if (!b6b_allocated(data))
+		return NULL;
+
+	/* path->s may be freed during context switch, while b6b_offload_timeout()
+	 * blocks */
+	data->path = b6b_strndup(path->s, path->slen);
+	if (b6b_unlikely(!data->path)) {
+		free(data);
+		return NULL;
+	}
+
+	data->fmode = fmode->fmode;
+	data->fp = NULL;
+
+	/* open the file through io_uring if possible, then wrap the file
+	 * descriptor with a FILE, which doesn't block */
+	if (b6b_uring_openat(interp,
+	                     data->path,
+	                     fmode->flags | O_CLOEXEC,
+	                     0666,
+	                     timeout,
+	                     &fd)) {
+		b6b_file_fopen_free(data);
+
+		if (fd < 0) {
+			/* the linked timeout cancels the operation */
+			b6b_return_strerror(interp,
+			                    (fd == -ECANCELED) ? ETIMEDOUT : -fd);
+			return NULL;
+		}
+
+		fp = fdopen(fd, fmode->fmode);
+		if (!fp) {
+			err = errno;
+			close(fd);
+			b6b_return_strerror(interp, err);
+		}
+
+		return fp;
+	}
+
+	/* on failure, the data is freed once fopen() is done */
+	if (!b6b_offload_timeout(interp,
+	                         b6b_file_do_fopen,
+	                         data,
+	                         b6b_file_fopen_free,
+	                         timeout))
+		return NULL;
+
+	fp = data->fp;
+	if (!fp)
+		b6b_return_strerror(interp, data->rerrno);
+
+	data->fp = NULL;
+	b6b_file_fopen_free(data);
+	return fp;
+}
+
 static enum b6b_res b6b_file_proc_open(struct b6b_interp *interp,
                                        struct b6b_obj *args)
 
 {
-	struct b6b_file_fopen_data data = {
-		.fp = NULL,
-		.fmode = b6b_file_def_mode.fmode
-	};
 	const struct b6b_file_mode *fmode = &b6b_file_def_mode;
-	struct b6b_obj *path, *mode, *f;
+	struct b6b_obj *path, *mode, *to, *f;
+	FILE *fp;
+	uint64_t timeout = B6B_FILE_OPEN_TIMEOUT;
 	int err, fd;
 
-	switch (b6b_proc_get_args(interp, args, "os|s", NULL, &path, &mode)) {
+	switch (b6b_proc_get_args(interp, args, "os|sf", NULL, &path, &mode, &to)) {
+		case 4:
+			if ((to->f <= 0) || (to->f > UINT_MAX))
+				return B6B_ERR;
+
+			timeout = (uint64_t)(to->f * 1000000000);
+
+			/* fall through */
 		case 3:
 			if (!b6b_as_str(mode))
 				return B6B_ERR;
@@ -171,37 +262,22 @@ static enum b6b_res b6b_file_proc_open(struct b6b_interp *interp,
 			if (!fmode)
 				return b6b_return_strerror(interp, EINVAL);
 
-			data.fmode = fmode->fmode;
-
+			/* fall through */
 		case 2:
-			/* path->s may be freed during context switch, while b6b_offload()
-			 * blocks */
-			data.path = b6b_strndup(path->s, path->slen);
-			if (b6b_unlikely(!data.path))
+			fp = b6b_file_fopen(interp, path, fmode, timeout);
+			if (!fp)
 				return B6B_ERR;
 
-			if (!b6b_offload(interp, b6b_file_do_fopen, &data)) {
-				if (data.fp)
-					b6b_offload(interp, b6b_stdio_do_fclose, data.fp);
-				free(data.path);
-				return B6B_ERR;
-			}
-
-			free(data.path);
-
-			if (!data.fp)
-				return b6b_return_strerror(interp, data.rerrno);
-
-			fd = fileno(data.fp);
+			fd = fileno(fp);
 			if (fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
 				err = errno;
-				b6b_offload(interp, b6b_stdio_do_fclose, data.fp);
+				b6b_offload(interp, b6b_stdio_do_fclose, fp);
 				return b6b_return_strerror(interp, err);
 			}
 
-			f = b6b_file_new(interp, data.fp, fd, fmode->bmode, fmode->ops);
+			f = b6b_file_new(interp, fp, fd, fmode->bmode, fmode->ops);
 			if (!f) {
-				b6b_offload(interp, b6b_stdio_do_fclose, data.fp);
+				b6b_offload(interp, b6b_stdio_do_fclose, fp);
 				return B6B_ERR;
 			}
 
@@ -0,0 +1,139 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2026 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <b6b.h>
+
+struct b6b_future {
+	struct b6b_obj *stmts;
+	/* the thread's return value and status, once it's done */
+	struct b6b_obj *res;
+	enum b6b_res status;
+	int done;
+	struct b6b_waitq waiters;
+};
+
+static void b6b_future_routine(struct b6b_thread *t, void *arg)
+{
+	struct b6b_interp *interp = (struct b6b_interp *)arg;
+	struct b6b_future *f = (struct b6b_future *)t->fn->priv;
+
+	f->status = b6b_call(interp, f->stmts);
+	f->res = b6b_ref(t->_);
+	f->done = 1;
+
+	b6b_notify_all(interp, &f->waiters);
+	b6b_stop(interp);
+}
+
+/* returns the thread's return value, or fails with the error it raised */
+static enum b6b_res b6b_future_result(struct b6b_interp *interp,
+                                      struct b6b_future *f)
+{
+	if (!f->done)
+		return B6B_ERR;
+
+	b6b_return(interp, b6b_ref(f->res));
+
+	switch (f->status) {
+		case B6B_ERR:
+		case B6B_EXIT:
+			return B6B_ERR;
+
+		default:
+			return B6B_OK;
+	}
+}
+
+static enum b6b_res b6b_future_proc(struct b6b_interp *interp,
+                                    struct b6b_obj *args)
+{
+	struct b6b_obj *o, *op;
+	struct b6b_future *f;
+
+	if (b6b_proc_get_args(interp, args, "os", &o, &op)) {
+		f = (struct b6b_future *)o->priv;
+
+		if (strcmp(op->s, "wait") == 0) {
+			while (!f->done) {
+				if (!b6b_wait_on(interp, &f->waiters))
+					return B6B_ERR;
+			}
+
+			return b6b_future_result(interp, f);
+		}
+		else if (strcmp(op->s, "done") == 0)
+			return b6b_return_bool(interp, f->done);
+		else if (strcmp(op->s, "result") == 0)
+			return b6b_future_result(interp, f);
+
+		b6b_return_fmt(interp, "bad future op: %s", op->s);
+	}
+
+	return B6B_ERR;
+}
+
+static void b6b_future_del(void *priv)
+{
+	struct b6b_future *f = (struct b6b_future *)priv;
+
+	b6b_unref(f->stmts);
+	if (f->res)
+		b6b_unref(f->res);
+
+	free(f);
+}
+
+struct b6b_obj *b6b_spawn(struct b6b_interp *interp,
+                          struct b6b_obj *stmts,
+                          const size_t stksiz,
+                          const int prio)
+{
+	struct b6b_obj *o;
+	struct b6b_future *f;
+
+	f = (struct b6b_future *)malloc(sizeof(*f));
+	if (!b6b_allocated(f))
+		return NULL;
+
+	o = b6b_str_fmt("future:%"PRIxPTR, (uintptr_t)f);
+	if (b6b_unlikely(!o)) {
+		free(f);
+		return NULL;
+	}
+
+	f->stmts = b6b_ref(stmts);
+	f->res = NULL;
+	f->done = 0;
+	b6b_waitq_init(&f->waiters);
+
+	o->priv = f;
+	o->proc = b6b_future_proc;
+	o->del = b6b_future_del;
+
+	/* the thread holds a reference to the handle until it's done */
+	if (!b6b_start_thread(interp, b6b_future_routine, o, stksiz, prio)) {
+		b6b_destroy(o);
+		return NULL;
+	}
+
+	return o;
+}
@@ -19,6 +19,8 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdarg.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -28,27 +30,209 @@
 
 #include <b6b.h>
 
+uint64_t b6b_now(void)
+{
+	struct timespec now;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &now) < 0)
+		return 0;
+
+	return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
 #ifdef B6B_HAVE_THREADS
 
-static void b6b_thread_routine(const int th,
-                               const int tl,
-                               const int ih,
-                               const int il)
+/* wakes sleeping threads with a deadline that has passed */
+static void b6b_poll_timers(struct b6b_interp *interp)
 {
-	struct b6b_interp *interp = (struct b6b_interp *)(uintptr_t)il;
-	struct b6b_thread *t = (struct b6b_thread *)(uintptr_t)tl;
+	struct b6b_thread *t;
+	uint64_t now;
+
+	t = b6b_thread_queued(&interp->sleeping);
+	if (!t)
+		return;
+
+	now = b6b_now();
+	do {
+		if (t->deadline > now)
+			break;
+
+		b6b_thread_dequeue(&interp->sleeping, t);
+		b6b_wake(interp, t);
+	} while ((t = b6b_thread_queued(&interp->sleeping)));
+}
+
+/* returns the time until the earliest deadline, in milliseconds, or -1 if
+ * there's no sleeping thread */
+static int b6b_timeout(struct b6b_interp *interp)
+{
+	const struct b6b_thread *t;
+	uint64_t now, ms;
+
+	t = b6b_thread_queued(&interp->sleeping);
+	if (!t)
+		return -1;
+
+	now = b6b_now();
+	if (t->deadline <= now)
+		return 0;
+
+	ms = (t->deadline - now + 999999) / 1000000;
+	return (ms > INT_MAX) ? INT_MAX : (int)ms;
+}
+
+#	ifdef B6B_HAVE_OFFLOAD_THREAD
 
-	if (sizeof(int) < sizeof(uintptr_t)) {
-#define INTBITS (sizeof(int) * 8)
-		interp = (struct b6b_interp *)(uintptr_t)((uint64_t)ih << INTBITS | (unsigned int)il);
-		t = (struct b6b_thread *)(uintptr_t)((uint64_t)th << INTBITS | (unsigned int)tl);
+/* frees a job that timed out, once it's done */
+static void b6b_offload_release(struct b6b_interp *interp,
+                                struct b6b_offload_job *job)
+{
+	--interp->offpool.nabandoned;
+	if (job->del)
+		job->del(job->arg);
+	free(job);
+}
+
+/* wakes threads waiting for offloaded jobs that are done */
+static void b6b_poll_offload(struct b6b_interp *interp)
+{
+	struct b6b_offload_job *job, *next;
+	struct b6b_thread *t;
+
+	if ((!interp->nbusy && !interp->offpool.nabandoned) ||
+	    !b6b_offload_pending(&interp->offpool))
+		return;
+
+	for (job = b6b_offload_reap(&interp->offpool); job; job = next) {
+		next = job->next;
+		job->done = 1;
+
+		if (job->abandoned)
+			b6b_offload_release(interp, job);
+		/* a thread waiting for a batch of jobs wakes up once the last one is
+		 * done, while a thread waiting until a deadline may have been woken up
+		 * by the timer already */
+		else if ((!job->left || !--*job->left) &&
+		         b6b_thread_parked(job->waiter)) {
+			if (job->timed)
+				b6b_thread_dequeue(&interp->sleeping, job->waiter);
+			b6b_wake(interp, job->waiter);
+		}
+
+		/* the job left the queue, so the next thread in line can queue
+		 * another one */
+		t = b6b_thread_queued(&interp->offwq);
+		if (t) {
+			b6b_thread_dequeue(&interp->offwq, t);
+			b6b_wake(interp, t);
+		}
 	}
+}
 
-	b6b_call(interp, t->fn);
+/* waits until an offloaded job is done; returns 0 if there's none */
+static int b6b_offload_idle(struct b6b_interp *interp)
+{
+	if (!interp->nbusy)
+		return 0;
+
+	return b6b_offload_wait(&interp->offpool);
+}
+
+#		define b6b_offload_arm_poll(interp) \
+	(!interp->nbusy || b6b_offload_arm(&(interp)->offpool))
+#		define b6b_offload_disarm_poll(interp) \
+	b6b_offload_disarm(&(interp)->offpool)
+
+#	else
+
+#		define b6b_poll_offload(interp) do {} while (0)
+#		define b6b_offload_idle(interp) 0
+#		define b6b_offload_arm_poll(interp) 1
+#		define b6b_offload_disarm_poll(interp) do {} while (0)
+
+#	endif
 
-	/* mark this thread as dead, switch to another and let b6b_wait() free it */
-	t->flags |= B6B_THREAD_DONE;
-	b6b_yield(interp);
+#	ifdef B6B_HAVE_IO_URING
+
+#		define b6b_poll_uring(interp) b6b_uring_reap(interp)
+#		define b6b_submit_uring(interp) b6b_uring_submit(&(interp)->uring)
+#		define b6b_uring_idle(interp) b6b_uring_busy(&(interp)->uring)
+
+#	else
+
+#		define b6b_poll_uring(interp) do {} while (0)
+#		define b6b_submit_uring(interp) do {} while (0)
+#		define b6b_uring_idle(interp) 0
+
+#	endif
+
+/* waits until a file descriptor is ready, the earliest deadline, an offloaded
+ * job is done or an io_uring operation is done */
+static int b6b_idle_poll(struct b6b_interp *interp)
+{
+	int ret;
+
+	if (!b6b_offload_arm_poll(interp))
+		return 1;
+
+	ret = b6b_io_poll(interp, b6b_timeout(interp)) >= 0;
+	b6b_offload_disarm_poll(interp);
+	return ret;
+}
+
+/* waits until at least one parked thread can run; returns 0 if none can */
+static int b6b_idle(struct b6b_interp *interp)
+{
+	struct b6b_thread *t;
+
+	/* submit io_uring operations queued by threads that can no longer run */
+	b6b_submit_uring(interp);
+
+	/* if the interpreter is exiting, blocked and sleeping threads should run
+	 * and exit */
+	if (interp->exit &&
+	    (b6b_thread_queued(&interp->blocked) ||
+	     b6b_thread_queued(&interp->sleeping))) {
+		while ((t = b6b_thread_queued(&interp->blocked)))
+			b6b_unblock(interp, t);
+
+		while ((t = b6b_thread_queued(&interp->sleeping))) {
+			b6b_thread_dequeue(&interp->sleeping, t);
+			b6b_wake(interp, t);
+		}
+
+		return 1;
+	}
+
+	if (b6b_reactor_busy(&interp->reactor)) {
+		/* if the interpreter is exiting, threads waiting for a file descriptor
+		 * should run and exit */
+		if (interp->exit) {
+			while ((t = b6b_thread_queued(&interp->reactor.waiting))) {
+				b6b_thread_dequeue(&interp->reactor.waiting, t);
+				b6b_wake(interp, t);
+			}
+
+			return 1;
+		}
+
+		return b6b_idle_poll(interp);
+	}
+
+	/* the reactor doubles as a timer that wakes up the earliest sleeping
+	 * thread, and it waits for io_uring operations too */
+	if (b6b_thread_queued(&interp->sleeping) || b6b_uring_idle(interp))
+		return b6b_idle_poll(interp);
+
+	return b6b_offload_idle(interp);
+}
+
+static void b6b_thread_routine(struct b6b_thread *t, void *arg)
+{
+	struct b6b_interp *interp = (struct b6b_interp *)arg;
+
+	b6b_call(interp, t->fn);
+	b6b_stop(interp);
 }
 
 #endif
@@ -97,6 +281,30 @@ static int b6b_interp_new_ext_obj(struct b6b_interp *interp,
 	return 1;
 }
 
+#ifdef B6B_HAVE_OFFLOAD_THREAD
+
+static unsigned int b6b_offload_max(const uint8_t opts)
+{
+	const char *s;
+	char *end;
+	unsigned long n;
+
+	if (opts & B6B_OPT_NO_POOL)
+		return 1;
+
+	s = getenv(B6B_OFFLOAD_THREADS_ENV);
+	if (!s || !*s)
+		return B6B_OFFLOAD_THREADS;
+
+	n = strtoul(s, &end, 10);
+	if (*end || !n)
+		return B6B_OFFLOAD_THREADS;
+
+	return (n > B6B_OFFLOAD_MAX) ? B6B_OFFLOAD_MAX : (unsigned int)n;
+}
+
+#endif
+
 int b6b_interp_new(struct b6b_interp *interp,
                    struct b6b_obj *args,
                    const uint8_t opts)
@@ -108,28 +316,24 @@ int b6b_interp_new(struct b6b_interp *interp,
 	interp->fg = NULL;
 #ifdef B6B_HAVE_THREADS
 	b6b_thread_init(&interp->threads);
-#	ifdef B6B_HAVE_OFFLOAD_THREAD
-	interp->noffths = sizeof(interp->offths) / sizeof(interp->offths[0]);
-	if (b6b_unlikely(opts & B6B_OPT_NO_POOL))
-		interp->noffths = 1;
-
-	for (j = 0; j < interp->noffths; ++j)
-		b6b_offload_thread_init(&interp->offths[j]);
+	b6b_thread_init(&interp->runq);
+	b6b_thread_init(&interp->doneq);
+	b6b_thread_init(&interp->blocked);
+	b6b_thread_init(&interp->sleeping);
+	b6b_reactor_init(&interp->reactor);
+#	ifdef B6B_HAVE_IO_URING
+	b6b_uring_init(&interp->uring);
 #	endif
-
-	/* we allocate a small stack (just two pages) */
-	interp->stksiz = sysconf(_SC_PAGESIZE);
-	if (interp->stksiz <= 0)
+	if (!b6b_stacks_init(&interp->stks, B6B_STACK_PAGES))
 		goto bail;
 
 #	ifdef B6B_HAVE_OFFLOAD_THREAD
-	for (j = 0; j < interp->noffths; ++j) {
-		if (!b6b_offload_thread_start(&interp->offths[j], j))
-			goto bail;
-	}
-#	endif
+	b6b_thread_init(&interp->offwq);
+	interp->nbusy = 0;
 
-	interp->stksiz *= 2;
+	if (!b6b_offload_pool_start(&interp->offpool, b6b_offload_max(opts)))
+		goto bail;
+#	endif
 #endif
 
 	interp->null = b6b_str_copy("", 0);
@@ -162,7 +366,10 @@ int b6b_interp_new(struct b6b_interp *interp,
 		goto bail;
 
 #ifdef B6B_HAVE_THREADS
-	interp->qstep = 0;
+	interp->quant = B6B_QUANT;
+	interp->qstart = b6b_now();
+	interp->polled = interp->qstart;
+	interp->nstmts = 0;
 	interp->exit = 0;
 #endif
 
@@ -170,7 +377,7 @@ int b6b_interp_new(struct b6b_interp *interp,
 	if (!interp->fg)
 		goto bail;
 #ifdef B6B_HAVE_THREADS
-	b6b_thread_push(&interp->threads, interp->fg, NULL);
+	TAILQ_INSERT_TAIL(&interp->threads, interp->fg, ents);
 #endif
 
 	interp->seed = (unsigned int)time(NULL);
@@ -239,12 +446,12 @@ static void b6b_join(struct b6b_interp *interp)
 #ifdef B6B_HAVE_THREADS
 	struct b6b_thread *t;
 #	ifdef B6B_HAVE_OFFLOAD_THREAD
-	int i;
+	struct b6b_offload_job *job, *next;
 #	endif
 
 	/* wait until all threads except the main thread are inactive */
 	interp->exit = 1;
-	do {} while (b6b_yield(interp));
+	do {} while (b6b_yield(interp) || b6b_idle(interp));
 
 	/* destroy the main thread */
 	t = b6b_thread_first(&interp->threads);
@@ -252,8 +459,13 @@ static void b6b_join(struct b6b_interp *interp)
 		b6b_thread_pop(&interp->threads, t);
 
 #	ifdef B6B_HAVE_OFFLOAD_THREAD
-	for (i = interp->noffths - 1; i >= 0; --i)
-		b6b_offload_thread_stop(&interp->offths[i]);
+	/* stop offload threads, except ones stuck in jobs that timed out, and free
+	 * jobs that timed out but finished meanwhile */
+	b6b_offload_pool_stop(&interp->offpool);
+	for (job = b6b_offload_reap(&interp->offpool); job; job = next) {
+		next = job->next;
+		b6b_offload_release(interp, job);
+	}
 #	endif
 
 #else
@@ -267,6 +479,14 @@ void b6b_interp_destroy(struct b6b_interp *interp)
 	if (interp->fg)
 		b6b_join(interp);
 
+#ifdef B6B_HAVE_THREADS
+#	ifdef B6B_HAVE_IO_URING
+	b6b_uring_destroy(&interp->uring);
+#	endif
+	b6b_reactor_destroy(&interp->reactor);
+	b6b_stacks_destroy(&interp->stks);
+#endif
+
 	if (interp->global)
 		b6b_frame_destroy(interp->global);
 
@@ -422,149 +642,416 @@ enum b6b_res b6b_eval(struct b6b_interp *interp, struct b6b_obj *exp)
 
 static void b6b_wait(struct b6b_interp *interp)
 {
-	struct b6b_thread *t, *tt;
+	struct b6b_thread *t;
 
-	b6b_thread_foreach_safe(&interp->threads, t, tt) {
-		if (t->flags & B6B_THREAD_DONE)
-			b6b_thread_pop(&interp->threads, t);
+	/* the current thread cannot be in the done queue: a dead thread never
+	 * runs again */
+	while ((t = b6b_thread_queued(&interp->doneq))) {
+		b6b_thread_dequeue(&interp->doneq, t);
+		b6b_thread_pop(&interp->threads, t);
+	}
+}
+
+static void b6b_switch(struct b6b_interp *interp, struct b6b_thread *t)
+{
+	struct b6b_thread *bg = interp->fg;
+
+	b6b_thread_dequeue(&interp->runq, t);
+	interp->qstart = b6b_now();
+
+	if (t != bg) {
+		interp->fg = t;
+		b6b_thread_swap(bg, t);
 	}
+
+	b6b_wait(interp);
 }
 
 int b6b_yield(struct b6b_interp *interp)
 {
-	struct b6b_thread *bg, *t;
+	struct b6b_thread *t;
+	uint64_t now;
+
+	b6b_submit_uring(interp);
+	b6b_poll_uring(interp);
+	b6b_poll_offload(interp);
+	b6b_poll_timers(interp);
+
+	/* polling file descriptors takes a system call, so we do that only if no
+	 * other thread can run, or once per time slice: threads waiting for a
+	 * file descriptor may wait up to a time slice longer, but they're not
+	 * starved by threads that yield all the time */
+	if (b6b_reactor_busy(&interp->reactor)) {
+		now = b6b_now();
+		if (!b6b_thread_queued(&interp->runq) ||
+		    (now - interp->polled >= interp->quant)) {
+			b6b_io_poll(interp, 0);
+			interp->polled = now;
+		}
+	}
+
+	t = b6b_thread_queued(&interp->runq);
+	if (!t) {
+		/* no thread to switch to, so the current one gets another slice */
+		interp->qstart = b6b_now();
+		b6b_wait(interp);
+		return 0;
+	}
+
+	b6b_thread_enqueue(&interp->runq, interp->fg);
+	b6b_switch(interp, t);
+	return 1;
+}
+
+int b6b_park(struct b6b_interp *interp)
+{
+	struct b6b_thread *t;
+
+	interp->fg->flags |= B6B_THREAD_PARKED;
+
+	do {
+		b6b_poll_uring(interp);
+		b6b_poll_offload(interp);
+		b6b_poll_timers(interp);
 
-#define THREAD_PENDING(t) \
-	(t->flags & B6B_THREAD_BG) && !(t->flags & B6B_THREAD_DONE)
+		t = b6b_thread_queued(&interp->runq);
+		if (t)
+			break;
 
-	t = b6b_thread_next(interp->fg);
-	while (t) {
-		if (THREAD_PENDING(t))
-			goto swap;
+		/* if no other thread can run, we wait for a file descriptor or let
+		 * one of the threads waiting for an offload thread block until it's
+		 * done; if there's no such thread, nothing can wake us up */
+		if (!b6b_idle(interp)) {
+			interp->fg->flags &= ~B6B_THREAD_PARKED;
+			return 0;
+		}
+	} while (1);
+
+	b6b_switch(interp, t);
+	return 1;
+}
+
+void b6b_stop(struct b6b_interp *interp)
+{
+	struct b6b_lock *l;
 
-		t = b6b_thread_next(t);
+	/* release locks the thread didn't release because it returned or raised
+	 * an error, so threads waiting for them don't block forever */
+	while ((l = b6b_lock_held(interp->fg))) {
+		b6b_lock_drop(l);
+		b6b_notify(interp, &l->waiters);
 	}
 
-	t = b6b_thread_first(&interp->threads);
-	while (t != interp->fg) {
-		if (THREAD_PENDING(t))
-			goto swap;
+	/* mark this thread as dead, switch to another and let b6b_wait() free it;
+	 * we never switch back to this thread */
+	interp->fg->flags |= B6B_THREAD_DONE;
+	b6b_thread_enqueue(&interp->doneq, interp->fg);
+	b6b_park(interp);
+}
+
+void b6b_wake(struct b6b_interp *interp, struct b6b_thread *t)
+{
+	t->flags &= ~B6B_THREAD_PARKED;
+
+	/* if the thread has a higher priority than the current one, it runs next
+	 * and the current thread's time slice ends after the current statement */
+	if (t->prio > interp->fg->prio) {
+		TAILQ_INSERT_HEAD(&interp->runq, t, qents);
+		interp->qstart = 0;
+	} else
+		b6b_thread_enqueue(&interp->runq, t);
+}
+
+int b6b_block(struct b6b_interp *interp)
+{
+	struct b6b_thread *t = interp->fg;
+
+	if (interp->exit)
+		return 0;
 
-		t = b6b_thread_next(t);
+	b6b_thread_enqueue(&interp->blocked, t);
+	if (!b6b_park(interp)) {
+		b6b_thread_dequeue(&interp->blocked, t);
+		return 0;
 	}
 
-	b6b_wait(interp);
-	return 0;
+	/* if the interpreter is exiting, we were woken up by b6b_join() */
+	return !interp->exit;
+}
 
-swap:
-	bg = interp->fg;
-	interp->fg = t;
-	interp->qstep = 0;
-	b6b_thread_swap(bg, interp->fg);
-	b6b_wait(interp);
-	return 1;
+void b6b_unblock(struct b6b_interp *interp, struct b6b_thread *t)
+{
+	b6b_thread_dequeue(&interp->blocked, t);
+	b6b_wake(interp, t);
+}
+
+/* queues a thread that sleeps until a deadline, in order */
+static void b6b_sleep_enqueue(struct b6b_interp *interp,
+                              struct b6b_thread *t,
+                              const uint64_t ns)
+{
+	struct b6b_thread *next;
+
+	t->deadline = b6b_now() + ns;
+
+	TAILQ_FOREACH(next, &interp->sleeping, qents) {
+		if (next->deadline > t->deadline)
+			break;
+	}
+
+	if (next)
+		TAILQ_INSERT_BEFORE(next, t, qents);
+	else
+		b6b_thread_enqueue(&interp->sleeping, t);
+}
+
+int b6b_sleep(struct b6b_interp *interp, const uint64_t ns)
+{
+	struct b6b_thread *t = interp->fg;
+
+	if (interp->exit)
+		return 0;
+
+	b6b_sleep_enqueue(interp, t, ns);
+
+	if (!b6b_park(interp)) {
+		b6b_thread_dequeue(&interp->sleeping, t);
+		return 0;
+	}
+
+	/* if the interpreter is exiting, we were woken up by b6b_join() */
+	return !interp->exit;
+}
+
+int b6b_wait_on(struct b6b_interp *interp, struct b6b_waitq *q)
+{
+	struct b6b_waiter w;
+	int ret;
+
+	b6b_waitq_add(q, &w, interp->fg);
+	ret = b6b_block(interp);
+	b6b_waitq_del(q, &w);
+
+	return ret;
+}
+
+/* wakes the first thread in q that is still blocked: a thread that waits for
+ * multiple objects may have been woken up by another one already */
+void b6b_notify(struct b6b_interp *interp, struct b6b_waitq *q)
+{
+	struct b6b_waiter *w;
+
+	while ((w = TAILQ_FIRST(q))) {
+		TAILQ_REMOVE(q, w, ents);
+		w->queued = 0;
+
+		if (b6b_thread_parked(w->t)) {
+			b6b_unblock(interp, w->t);
+			return;
+		}
+	}
+}
+
+void b6b_notify_all(struct b6b_interp *interp, struct b6b_waitq *q)
+{
+	while (TAILQ_FIRST(q))
+		b6b_notify(interp, q);
 }
 
 #endif
 
 #ifdef B6B_HAVE_OFFLOAD_THREAD
 
-static struct b6b_offload_thread *b6b_pick_thread(struct b6b_interp *interp)
+/* queues a job, after threads already waiting for a free slot */
+static int b6b_offload_queue(struct b6b_interp *interp,
+                             struct b6b_offload_job *job)
 {
-	unsigned int i;
-
-	for (i = 0; i < interp->noffths; ++i) {
-		if (b6b_offload_ready(&interp->offths[i]))
-			return &interp->offths[i];
+	/* if the queue is full or other threads are already waiting for a free
+	 * slot, wait in line */
+	if (b6b_thread_queued(&interp->offwq) ||
+	    !b6b_offload_submit(&interp->offpool, job)) {
+		do {
+			b6b_thread_enqueue(&interp->offwq, interp->fg);
+			if (!b6b_park(interp)) {
+				b6b_thread_dequeue(&interp->offwq, interp->fg);
+				return 0;
+			}
+		} while (!b6b_offload_submit(&interp->offpool, job));
 	}
 
-	return NULL;
+	return 1;
 }
 
 int b6b_offload(struct b6b_interp *interp,
                 void (*fn)(void *),
                 void *arg)
 {
-	struct b6b_thread *t;
-	int swap, pending = 0;
-	struct b6b_offload_thread *offth = NULL;
+	struct b6b_offload_job job = {
+		.fn = fn,
+		.arg = arg,
+		.waiter = interp->fg,
+		.del = NULL,
+		.left = NULL,
+		.timed = 0,
+		.done = 0,
+		.abandoned = 0
+	};
+
+	/* if the interpreter thread cannot wait for offload threads, run the job
+	 * here */
+	if (!b6b_threaded(interp) || !b6b_offload_pool_open(&interp->offpool)) {
+		fn(arg);
+		return 1;
+	}
 
-	if (!b6b_threaded(interp))
+	if (!b6b_offload_queue(interp, &job))
+		return 0;
+
+	/* switch to other threads until the job is done; since there's a queued
+	 * job, b6b_park() cannot fail */
+	++interp->nbusy;
+	b6b_park(interp);
+	--interp->nbusy;
+
+	return 1;
+}
+
+int b6b_offload_timeout(struct b6b_interp *interp,
+                        void (*fn)(void *),
+                        void *arg,
+                        void (*del)(void *),
+                        const uint64_t timeout)
+{
+	struct b6b_offload_job *job;
+
+	if (!b6b_threaded(interp) || !b6b_offload_pool_open(&interp->offpool)) {
 		fn(arg);
-	else {
-		b6b_thread_block(interp->fg);
+		return 1;
+	}
 
-		do {
-			offth = b6b_pick_thread(interp);
-			if (offth)
-				break;
-
-			/* if the offload thread is busy but no other thread is running,
-			 * this is clearly a serious bug */
-			if (!b6b_yield(interp)) {
-				b6b_thread_unblock(interp->fg);
-				return 0;
-			}
-		} while (1);
+	/* the job may outlive the calling thread's stack */
+	job = (struct b6b_offload_job *)malloc(sizeof(*job));
+	if (!b6b_allocated(job)) {
+		del(arg);
+		return 0;
+	}
 
-		if (!b6b_offload_start(offth, fn, arg)) {
-			b6b_thread_unblock(interp->fg);
-			return 0;
-		}
+	job->fn = fn;
+	job->arg = arg;
+	job->waiter = interp->fg;
+	job->del = del;
+	job->left = NULL;
+	job->timed = 1;
+	job->done = 0;
+	job->abandoned = 0;
+
+	if (!b6b_offload_queue(interp, job)) {
+		del(arg);
+		free(job);
+		return 0;
+	}
 
-		do {
-			/* if this is the only remaining active thread, we cannot poll for
-			 * b6b_offload_done() since b6b_yield() doesn't do anything; in this
-			 * case, we let b6b_offload_finish() block */
-			if (!b6b_threaded(interp))
-				break;
-
-			/* check whether there is at least one thread that waits for us to
-			 * complete the blocking operation and at least one thread which
-			 * doesn't */
-			pending = swap = 0;
-			b6b_thread_foreach(&interp->threads, t) {
-				if (t != interp->fg) {
-					if (b6b_thread_blocked(t)) {
-						pending = 1;
-						if (swap)
-							break;
-					}
-					else {
-						swap = 1;
-						if (pending)
-							break;
-					}
-				}
-			}
+	/* sleep until the job is done or the deadline passes, whichever comes
+	 * first */
+	b6b_sleep_enqueue(interp, interp->fg, timeout);
+	++interp->nbusy;
+	b6b_park(interp);
+	--interp->nbusy;
 
-			/* if all other threads are blocked by us, we want to stop this
-			 * polling loop since all they do is repeatedly calling
-			 * b6b_yield() */
-			if (!swap)
-				break;
+	if (job->done) {
+		free(job);
+		return 1;
+	}
 
-			/* if all other threads exited during the previous iterations of
-			 * this loop, we can (and should) block */
-			if (!b6b_yield(interp))
-				break;
-		} while (!b6b_offload_done(offth));
+	/* give up on the job: the offload thread may be stuck, so the pool
+	 * replaces it until the job is done, then the job is freed */
+	job->abandoned = 1;
+	++interp->offpool.nabandoned;
 
-		b6b_thread_unblock(interp->fg);
+	if (!interp->exit)
+		b6b_return_strerror(interp, ETIMEDOUT);
 
-		if (!b6b_offload_finish(offth))
-			return 0;
+	return 0;
+}
+
+int b6b_offload_batch(struct b6b_interp *interp,
+                      void (*fn)(void *),
+                      void **args,
+                      const size_t n)
+{
+	struct b6b_offload_job *jobs;
+	size_t i, left = n;
+
+	/* unlike b6b_offload(), offload even if there's only one thread: this is
+	 * where the jobs run in parallel */
+	if (!b6b_offload_pool_open(&interp->offpool)) {
+		for (i = 0; i < n; ++i)
+			fn(args[i]);
 
-		/* if there's at least one thread which waits for us to complete the
-		 * blocking operation, we must give it a chance to run - otherwise, if
-		 * the next statement of the current thread also calls
-		 * b6b_offload_start(), that thread will spend more time in its
-		 * b6b_offload_ready() loop */
-		if (pending)
-			b6b_yield(interp);
+		return 1;
 	}
 
-	return 1;
+	if (!n)
+		return 1;
+
+	if (n > SIZE_MAX / sizeof(*jobs))
+		return 0;
+
+	jobs = (struct b6b_offload_job *)malloc(sizeof(*jobs) * n);
+	if (!b6b_allocated(jobs))
+		return 0;
+
+	for (i = 0; i < n; ++i) {
+		jobs[i].fn = fn;
+		jobs[i].arg = args[i];
+		jobs[i].waiter = interp->fg;
+		jobs[i].del = NULL;
+		jobs[i].left = &left;
+		jobs[i].timed = 0;
+		jobs[i].done = 0;
+		jobs[i].abandoned = 0;
+
+		/* while this thread waits for a free slot, jobs queued earlier may be
+		 * done, but it's not woken up until the rest are queued and done */
+		if (!b6b_offload_queue(interp, &jobs[i])) {
+			left -= n - i;
+			break;
+		}
+
+		if (i == 0)
+			++interp->nbusy;
+	}
+
+	/* wait for all queued jobs, even if some could not be queued; since
+	 * there's a queued job, b6b_park() cannot fail */
+	if (i > 0) {
+		if (left)
+			b6b_park(interp);
+
+		--interp->nbusy;
+	}
+
+	free(jobs);
+	return i == n;
+}
+
+#endif
+
+#ifdef B6B_HAVE_THREADS
+
+/* reading the clock after every statement is too expensive, so we do that
+ * every B6B_QUANT_STMTS statements: a time slice may be a few statements
+ * longer */
+static int b6b_preempted(struct b6b_interp *interp)
+{
+	if (!interp->qstart || !interp->quant)
+		return 1;
+
+	if (++interp->nstmts < B6B_QUANT_STMTS)
+		return 0;
+
+	interp->nstmts = 0;
+	return b6b_now() - interp->qstart >= interp->quant;
 }
 
 #endif
@@ -577,10 +1064,6 @@ static enum b6b_res b6b_on_res(struct b6b_interp *interp,
 		return B6B_OK;
 	}
 
-#ifdef B6B_HAVE_THREADS
-	++interp->qstep;
-#endif
-
 	/* update _ of the calling frame */
 	if (b6b_unlikely(!b6b_local(interp, interp->_, interp->fg->_)))
 		return B6B_ERR;
@@ -592,20 +1075,52 @@ static enum b6b_res b6b_on_res(struct b6b_interp *interp,
 		return res;
 	}
 
-	/* switch to another thread after each batch of B6B_QUANT_LEN statements */
-	if (interp->qstep == B6B_QUANT_LEN)
+	/* switch to another thread when the time slice is over, or if a thread
+	 * with higher priority preempts this one */
+	if (b6b_threaded(interp) && b6b_preempted(interp))
 		b6b_yield(interp);
 #endif
 
 	return res;
 }
 
+/* calls a procedure with the arguments of a frame, which are already
+ * evaluated */
+static enum b6b_res b6b_frame_call(struct b6b_interp *interp,
+                                   struct b6b_frame *f)
+{
+	const char *p;
+
+	if (interp->opts & B6B_OPT_TRACE) {
+		if (!b6b_as_str(f->args))
+			return B6B_ERR;
+
+		if (fwrite("+ ", 2, 1, stderr) != 1)
+			return B6B_ERR;
+
+		p = strchr(f->args->s, '\n');
+		if (p) {
+			if ((fwrite(f->args->s, p - f->args->s, 1, stderr) != 1) ||
+			    (fwrite(" ...\n", 5, 1, stderr) != 1))
+				return B6B_ERR;
+		}
+		else if ((fwrite(f->args->s, f->args->slen, 1, stderr) != 1) ||
+		         (fputc('\n', stderr) != '\n'))
+			return B6B_ERR;
+	}
+
+	/* reset the return value after argument evaluation */
+	b6b_unref(interp->fg->_);
+	interp->fg->_ = b6b_ref(interp->null);
+
+	return b6b_list_first(f->args)->o->proc(interp, f->args);
+}
+
 static enum b6b_res b6b_stmt_call(struct b6b_interp *interp,
                                   struct b6b_obj *stmt)
 {
 	struct b6b_litem *li;
 	struct b6b_frame *f;
-	const char *p;
 	enum b6b_res res = B6B_ERR;
 
 #ifdef B6B_HAVE_THREADS
@@ -632,29 +1147,46 @@ static enum b6b_res b6b_stmt_call(struct b6b_interp *interp,
 			goto pop;
 	}
 
-	if (interp->opts & B6B_OPT_TRACE) {
-		if (!b6b_as_str(f->args))
-			goto pop;
+	res = b6b_frame_call(interp, f);
 
-		if (fwrite("+ ", 2, 1, stderr) != 1)
-			goto pop;
+pop:
+	b6b_frame_pop(interp);
 
-		p = strchr(f->args->s, '\n');
-		if (p) {
-			if ((fwrite(f->args->s, p - f->args->s, 1, stderr) != 1) ||
-			    (fwrite(" ...\n", 5, 1, stderr) != 1))
-				goto pop;
-		}
-		else if ((fwrite(f->args->s, f->args->slen, 1, stderr) != 1) ||
-		         (fputc('\n', stderr) != '\n'))
+out:
+	return b6b_on_res(interp, res);
+}
+
+enum b6b_res b6b_call_proc(struct b6b_interp *interp,
+                           struct b6b_obj *proc,
+                           ...)
+{
+	va_list ap;
+	struct b6b_frame *f;
+	struct b6b_obj *o;
+	enum b6b_res res = B6B_ERR;
+
+#ifdef B6B_HAVE_THREADS
+	if (interp->exit)
+		return B6B_EXIT;
+#endif
+
+	f = b6b_frame_push(interp);
+	if (b6b_unlikely(!f))
+		goto out;
+
+	if (b6b_unlikely(!b6b_list_add(f->args, proc)))
+		goto pop;
+
+	va_start(ap, proc);
+	while ((o = va_arg(ap, struct b6b_obj *))) {
+		if (b6b_unlikely(!b6b_list_add(f->args, o))) {
+			va_end(ap);
 			goto pop;
+		}
 	}
+	va_end(ap);
 
-	/* reset the return value after argument evaluation */
-	b6b_unref(interp->fg->_);
-	interp->fg->_ = b6b_ref(interp->null);
-
-	res = b6b_list_first(f->args)->o->proc(interp, f->args);
+	res = b6b_frame_call(interp, f);
 
 pop:
 	b6b_frame_pop(interp);
@@ -703,25 +1235,39 @@ enum b6b_res b6b_call_copy(struct b6b_interp *interp,
 
 #ifdef B6B_HAVE_THREADS
 
-int b6b_start(struct b6b_interp *interp, struct b6b_obj *stmts)
+int b6b_start_thread(struct b6b_interp *interp,
+                     b6b_thread_entry entry,
+                     struct b6b_obj *fn,
+                     const size_t stksiz,
+                     const int prio)
 {
 	struct b6b_thread *t;
 
 	t = b6b_thread_new(&interp->threads,
-	                   stmts,
+	                   fn,
 	                   interp->global,
 	                   interp->null,
-	                   b6b_thread_routine,
+	                   entry,
 	                   interp,
-	                   (size_t)interp->stksiz);
+	                   &interp->stks,
+	                   stksiz);
 	if (t) {
-		b6b_thread_push(&interp->threads, t, interp->fg);
+		t->prio = prio;
+		b6b_thread_push(&interp->threads, &interp->runq, t);
 		return 1;
 	}
 
 	return 0;
 }
 
+int b6b_start(struct b6b_interp *interp,
+              struct b6b_obj *stmts,
+              const size_t stksiz,
+              const int prio)
+{
+	return b6b_start_thread(interp, b6b_thread_routine, stmts, stksiz, prio);
+}
+
 #endif
 
 enum b6b_res b6b_source(struct b6b_interp *interp, const char *path)
@@ -80,10 +80,14 @@ void b6b_list_flush(struct b6b_obj *l)
 	if (l->flags & B6B_TYPE_STR)
 		free(l->s);
 
+	b6b_cache_flush(l);
+
 	l->flags &= ~(B6B_TYPE_INT |
 	              B6B_TYPE_FLOAT |
 	              B6B_TYPE_STR |
-	              B6B_OBJ_HASHED);
+	              B6B_OBJ_HASHED |
+	              B6B_STR_UTF8 |
+	              B6B_STR_ASCII);
 
 #ifdef B6B_HAVE_VALGRIND
 	VALGRIND_MAKE_MEM_UNDEFINED(&l->s, sizeof(l->s));
@@ -50,6 +50,7 @@ struct b6b_obj *b6b_new(void)
 		o->refc = 1;
 		o->proc = b6b_obj_proc;
 		o->del = NULL;
+		o->cache = NULL;
 	}
 
 	return o;
@@ -69,6 +70,18 @@ void b6b_destroy_l(struct b6b_obj *o)
 #endif
 }
 
+void b6b_cache_flush(struct b6b_obj *o)
+{
+	struct b6b_cache *c, *next;
+
+	for (c = o->cache; c; c = next) {
+		next = c->next;
+		c->del(c);
+	}
+
+	o->cache = NULL;
+}
+
 void b6b_destroy(struct b6b_obj *o)
 {
 	if (o->flags & B6B_TYPE_LIST)
@@ -77,6 +90,8 @@ void b6b_destroy(struct b6b_obj *o)
 	if (o->flags & B6B_TYPE_STR)
 		free(o->s);
 
+	b6b_cache_flush(o);
+
 	if (o->del)
 		o->del(o->priv);
 
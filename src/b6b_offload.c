@@ -1,7 +1,7 @@
 /*
  * This file is part of b6b.
  *
- * Copyright 2017, 2020 Dima Krasner
+ * Copyright 2017, 2020, 2026 Dima Krasner
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -18,124 +18,354 @@
 
 #include <pthread.h>
 #include <signal.h>
-#include <assert.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include <b6b.h>
 
-__attribute__((noreturn))
+/* returns 0 if the timeout has expired */
+static int b6b_futex_wait(atomic_int *uaddr,
+                          const int val,
+                          const struct timespec *timeout)
+{
+	return !((syscall(SYS_futex,
+	                  uaddr,
+	                  FUTEX_WAIT_PRIVATE,
+	                  val,
+	                  timeout,
+	                  NULL,
+	                  0) < 0) &&
+	         (errno == ETIMEDOUT));
+}
+
+static void b6b_futex_wake(atomic_int *uaddr, const int n)
+{
+	syscall(SYS_futex, uaddr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+
+static struct b6b_offload_job *b6b_offload_dequeue(
+                                               struct b6b_offload_pool *pool)
+{
+	struct b6b_offload_slot *slot;
+	struct b6b_offload_job *job;
+	size_t pos, seq;
+
+	pos = atomic_load_explicit(&pool->head, memory_order_relaxed);
+	do {
+		slot = &pool->q[pos % B6B_OFFLOAD_QLEN];
+		seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+
+		/* the queue is empty */
+		if (seq != pos + 1) {
+			if ((ptrdiff_t)(seq - (pos + 1)) < 0)
+				return NULL;
+
+			/* another offload thread dequeued this job */
+			pos = atomic_load_explicit(&pool->head, memory_order_relaxed);
+			continue;
+		}
+
+		if (atomic_compare_exchange_weak_explicit(&pool->head,
+		                                          &pos,
+		                                          pos + 1,
+		                                          memory_order_relaxed,
+		                                          memory_order_relaxed))
+			break;
+	} while (1);
+
+	job = slot->job;
+
+	/* mark the slot as free for the next round */
+	atomic_store_explicit(&slot->seq,
+	                      pos + B6B_OFFLOAD_QLEN,
+	                      memory_order_release);
+
+	return job;
+}
+
+static void b6b_offload_complete(struct b6b_offload_pool *pool,
+                                 struct b6b_offload_job *job)
+{
+	job->next = atomic_load(&pool->done);
+	while (!atomic_compare_exchange_weak(&pool->done, &job->next, job));
+
+	/* if the interpreter thread is waiting, only the first job to be done
+	 * wakes it up */
+	if (atomic_exchange(&pool->waiting, 0))
+		eventfd_write(pool->efd, 1);
+}
+
 static void *b6b_offload_thread_routine(void *arg)
 {
-	struct b6b_offload_thread *t = (struct b6b_offload_thread *)arg;
-	int sig;
-
-	/* block all signals */
-	if (pthread_sigmask(SIG_BLOCK, &t->mask, NULL) != 0)
-		pthread_exit(NULL);
-
-	/* notify the main thread that initialization is complete */
-	atomic_store(&t->state, B6B_OFFLOAD_UP);
-	if (pthread_kill(t->main, t->sig) != 0)
-		pthread_exit(NULL);
-
-	/* block until t->sig; we wait only for this signal so we don't unqueue
-	 * signals handled by other threads */
-	while ((sigwait(&t->wmask, &sig) == 0) &&
-	       (atomic_load(&t->state) == B6B_OFFLOAD_RUNNING)) {
-		t->fn(t->arg);
-
-		/* signal b6b_offload_done() - we need this state to prevent a thread
-		 * from calling b6b_offload_start() (hence, changing the state to
-		 * B6B_OFFLOAD_RUNNING) when the previous user of the offload thread
-		 * calls b6b_yield() while waiting for completion */
-		atomic_store(&t->state, B6B_OFFLOAD_DONE);
-
-		/* in addition, notify the main thread using a signal: in the special
-		 * case of a single b6b thread we also need an alternative, blocking
-		 * mechanism for waiting until b6b_offload_done(); without this, the
-		 * only way to wait until b6b_offload_done() is a CPU-heavy loop of
-		 * b6b_yield() which doesn't do anything because there's no other
-		 * thread to switch to */
-		if (pthread_kill(t->main, t->sig) != 0)
-			pthread_exit(NULL);
+	struct b6b_offload_worker *w = (struct b6b_offload_worker *)arg;
+	struct b6b_offload_pool *pool = w->pool;
+	struct b6b_offload_job *job;
+	struct timespec timeout = {.tv_sec = pool->timeout};
+	int jobs, idle, state;
+
+	while (!atomic_load(&pool->stop)) {
+		job = b6b_offload_dequeue(pool);
+		if (!job) {
+			/* announce that we're going to sleep, then check again, so the
+			 * interpreter thread either sees us sleeping or we see its job */
+			atomic_fetch_add(&pool->nidle, 1);
+			jobs = atomic_load(&pool->jobs);
+			job = b6b_offload_dequeue(pool);
+			idle = 0;
+			if (!job && !atomic_load(&pool->stop))
+				idle = !b6b_futex_wait(&pool->jobs, jobs, &timeout);
+			atomic_fetch_sub(&pool->nidle, 1);
+
+			if (!job) {
+				if (!idle)
+					continue;
+
+				/* leave the pool, then check again: the interpreter thread
+				 * spawns a new offload thread if it sees none, so it won't
+				 * miss a job queued meanwhile */
+				atomic_fetch_sub(&pool->nthreads, 1);
+				job = b6b_offload_dequeue(pool);
+				if (!job)
+					break;
+
+				atomic_fetch_add(&pool->nthreads, 1);
+			}
+		}
+
+		atomic_store(&job->state, B6B_OFFLOAD_JOB_RUNNING);
+		atomic_store(&w->job, job);
+
+		/* once the interpreter is exiting, the only queued jobs are ones that
+		 * timed out, which may never finish */
+		if (!atomic_load(&pool->stop))
+			job->fn(job->arg);
+
+		/* if the interpreter left us behind, the pool may be gone already and
+		 * nobody else is going to free the job */
+		state = B6B_OFFLOAD_JOB_RUNNING;
+		if (!atomic_compare_exchange_strong(&job->state,
+		                                    &state,
+		                                    B6B_OFFLOAD_JOB_DONE)) {
+			if (job->del)
+				job->del(job->arg);
+			free(job);
+			return NULL;
+		}
+
+		atomic_store(&w->job, NULL);
+		b6b_offload_complete(pool, job);
 	}
 
-	pthread_exit(NULL);
+	atomic_store(&w->state, B6B_OFFLOAD_EXITED);
+	return NULL;
 }
 
-int b6b_offload_thread_start(struct b6b_offload_thread *t, const int id)
+static void b6b_offload_join(struct b6b_offload_worker *w)
 {
-	int sig;
+	pthread_join(w->tid, NULL);
+	atomic_store(&w->state, B6B_OFFLOAD_FREE);
+}
 
-	if ((sigfillset(&t->mask) < 0) || (sigemptyset(&t->wmask) < 0))
-		return 0;
+/* spawns an offload thread, in the slot of one that exited if there's such */
+static int b6b_offload_spawn(struct b6b_offload_pool *pool)
+{
+	sigset_t mask, omask;
+	unsigned int i;
+	int ret;
 
-	/* pick a high realtime signal and add it to both masks */
-	t->sig = SIGRTMAX - id - 1;
-	assert(t->sig >= SIGRTMIN);
-	if ((t->sig < SIGRTMIN) ||
-	    (sigaddset(&t->mask, t->sig) < 0) ||
-	    (sigaddset(&t->wmask, t->sig) < 0))
-		return 0;
+	for (i = 0; i < B6B_OFFLOAD_MAX; ++i) {
+		switch (atomic_load(&pool->workers[i].state)) {
+			case B6B_OFFLOAD_EXITED:
+				b6b_offload_join(&pool->workers[i]);
+				/* fall through */
 
-	/* block only the realtime signal; we do not restore the signal mask because
-	 * this is racy in multi-threaded processes that may alter their signal mask
-	 * after we blocked t->sig */
-	if (pthread_sigmask(SIG_BLOCK, &t->wmask, NULL) != 0)
-		return 0;
+			case B6B_OFFLOAD_FREE:
+				goto spawn;
+		}
+	}
 
-	t->main = pthread_self();
-	if (pthread_create(&t->tid, NULL, b6b_offload_thread_routine, t) != 0)
+	return 0;
+
+spawn:
+	/* offload threads inherit a signal mask that blocks all signals */
+	if ((sigfillset(&mask) < 0) ||
+	    (pthread_sigmask(SIG_SETMASK, &mask, &omask) != 0))
 		return 0;
 
-	/* wait for the offload thread to send the realtime signal once
-	 * initialization is complete */
-	do {
-		if ((sigwait(&t->wmask, &sig) != 0) || (sig != t->sig)) {
-			pthread_cancel(t->tid);
-			pthread_join(t->tid, NULL);
-			return 0;
-		}
-	} while (atomic_load(&t->state) != B6B_OFFLOAD_UP);
+	atomic_fetch_add(&pool->nthreads, 1);
+	atomic_store(&pool->workers[i].state, B6B_OFFLOAD_RUNNING);
+	ret = pthread_create(&pool->workers[i].tid,
+	                     NULL,
+	                     b6b_offload_thread_routine,
+	                     &pool->workers[i]);
+	if (ret != 0) {
+		atomic_store(&pool->workers[i].state, B6B_OFFLOAD_FREE);
+		atomic_fetch_sub(&pool->nthreads, 1);
+	}
+
+	pthread_sigmask(SIG_SETMASK, &omask, NULL);
+	return ret == 0;
+}
 
-	/* signal b6b_offload_ready() */
-	atomic_store(&t->state, B6B_OFFLOAD_IDLE);
+int b6b_offload_pool_start(struct b6b_offload_pool *pool,
+                           const unsigned int max)
+{
+	size_t i;
 
+	for (i = 0; i < B6B_OFFLOAD_QLEN; ++i) {
+		atomic_init(&pool->q[i].seq, i);
+		pool->q[i].job = NULL;
+	}
+
+	for (i = 0; i < B6B_OFFLOAD_MAX; ++i) {
+		pool->workers[i].pool = pool;
+		atomic_init(&pool->workers[i].state, B6B_OFFLOAD_FREE);
+		atomic_init(&pool->workers[i].job, NULL);
+	}
+
+	atomic_init(&pool->head, 0);
+	pool->tail = 0;
+	atomic_init(&pool->jobs, 0);
+	atomic_init(&pool->nidle, 0);
+	atomic_init(&pool->done, NULL);
+	atomic_init(&pool->waiting, 0);
+	atomic_init(&pool->stop, 0);
+	atomic_init(&pool->nthreads, 0);
+	pool->max = max;
+	pool->timeout = B6B_OFFLOAD_IDLE_TIMEOUT;
+	pool->nabandoned = 0;
+
+#ifdef B6B_HAVE_VALGRIND
+	/* all accesses to jobs in the queue are ordered by the slot sequence
+	 * numbers */
+	VALGRIND_HG_DISABLE_CHECKING(pool->q, sizeof(pool->q));
+#endif
+
+	pool->efd = -1;
 	return 1;
 }
 
-void b6b_offload_thread_stop(struct b6b_offload_thread *t)
+int b6b_offload_pool_open(struct b6b_offload_pool *pool)
 {
-	if (atomic_load(&t->state) != B6B_OFFLOAD_INIT) {
-		pthread_cancel(t->tid);
-		pthread_join(t->tid, NULL);
+	if (pool->efd < 0)
+		pool->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	return pool->efd >= 0;
+}
+
+void b6b_offload_pool_stop(struct b6b_offload_pool *pool)
+{
+	struct b6b_offload_worker *w;
+	struct b6b_offload_job *job;
+	unsigned int i;
+	int state;
+
+	atomic_store(&pool->stop, 1);
+	atomic_fetch_add(&pool->jobs, 1);
+	b6b_futex_wake(&pool->jobs, INT_MAX);
+
+	for (i = 0; i < B6B_OFFLOAD_MAX; ++i) {
+		w = &pool->workers[i];
+		if (atomic_load(&w->state) == B6B_OFFLOAD_FREE)
+			continue;
+
+		/* an offload thread stuck in a job that timed out may never exit, so
+		 * we leave it behind with the job, unless it's done already */
+		job = atomic_load(&w->job);
+		state = B6B_OFFLOAD_JOB_RUNNING;
+		if (job &&
+		    job->abandoned &&
+		    atomic_compare_exchange_strong(&job->state,
+		                                   &state,
+		                                   B6B_OFFLOAD_JOB_DETACHED)) {
+			pthread_detach(w->tid);
+			atomic_store(&w->state, B6B_OFFLOAD_FREE);
+		} else
+			b6b_offload_join(w);
 	}
+
+	if (pool->efd >= 0)
+		close(pool->efd);
 }
 
-int b6b_offload_start(struct b6b_offload_thread *t,
-                      void (*fn)(void *),
-                      void *arg)
+int b6b_offload_submit(struct b6b_offload_pool *pool,
+                       struct b6b_offload_job *job)
 {
-	/* falsify b6b_offload_ready() */
-	atomic_store(&t->state, B6B_OFFLOAD_RUNNING);
-	t->fn = fn;
-	t->arg = arg;
+	struct b6b_offload_slot *slot = &pool->q[pool->tail % B6B_OFFLOAD_QLEN];
 
-	/* wake up the offload thread */
-	if (pthread_kill(t->tid, t->sig) != 0)
+	/* the slot still holds a job from the previous round */
+	if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pool->tail)
 		return 0;
 
+	atomic_init(&job->state, B6B_OFFLOAD_JOB_QUEUED);
+	slot->job = job;
+	atomic_store_explicit(&slot->seq, pool->tail + 1, memory_order_release);
+	++pool->tail;
+
+	/* wake up a sleeping offload thread, if there's any: otherwise, spawn
+	 * another one if the pool can grow, or a busy one will dequeue the job once
+	 * it's done; offload threads stuck in jobs that timed out are replaced */
+	atomic_fetch_add(&pool->jobs, 1);
+	if (atomic_load(&pool->nidle))
+		b6b_futex_wake(&pool->jobs, 1);
+	else if ((atomic_load(&pool->nthreads) <
+	          pool->max + pool->nabandoned) &&
+	         !b6b_offload_spawn(pool) &&
+	         !atomic_load(&pool->nthreads)) {
+		/* if there's no offload thread to run the job, run it here */
+		while ((job = b6b_offload_dequeue(pool))) {
+			job->fn(job->arg);
+			b6b_offload_complete(pool, job);
+		}
+	}
+
 	return 1;
 }
 
-int b6b_offload_finish(struct b6b_offload_thread *t)
+struct b6b_offload_job *b6b_offload_reap(struct b6b_offload_pool *pool)
 {
-	int sig;
+	struct b6b_offload_job *job, *next, *prev = NULL;
 
-	/* sigwait() should return almost instantly if b6b_offload_done(); we call
-	 * it to unqueue the signal */
-	if ((sigwait(&t->wmask, &sig) != 0) || (sig != t->sig))
-		return 0;
+	/* the stack is in reverse order of completion */
+	job = atomic_exchange(&pool->done, NULL);
+	for (; job; job = next) {
+		next = job->next;
+		job->next = prev;
+		prev = job;
+	}
+
+	return prev;
+}
 
-	atomic_store(&(t)->state, B6B_OFFLOAD_IDLE);
+int b6b_offload_wait(struct b6b_offload_pool *pool)
+{
+	struct pollfd pfd = {.fd = pool->efd, .events = POLLIN};
+
+	if (!b6b_offload_arm(pool))
+		return 1;
+
+	/* the eventfd may be readable because a job was done after the previous
+	 * wait: in this case, the caller may find no completed job and wait
+	 * again */
+	if (poll(&pfd, 1, -1) < 0) {
+		b6b_offload_disarm(pool);
+		return errno == EINTR;
+	}
+
+	b6b_offload_disarm(pool);
+	b6b_offload_drain(pool);
 	return 1;
 }
+
+void b6b_offload_drain(struct b6b_offload_pool *pool)
+{
+	eventfd_t val;
+
+	eventfd_read(pool->efd, &val);
+}
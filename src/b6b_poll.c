@@ -17,6 +17,7 @@
  */
 
 #include <sys/epoll.h>
+#include <poll.h>
 #include <errno.h>
 #include <unistd.h>
 #include <stdint.h>
@@ -27,162 +28,340 @@
 
 #include <b6b.h>
 
-static enum b6b_res b6b_poll_proc(struct b6b_interp *interp,
-                                  struct b6b_obj *args)
+#define B6B_POLL_EVENTS \
+	(EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET | EPOLLONESHOT)
+
+struct b6b_poll {
+	struct epoll_event *evs;
+	struct b6b_obj *res;
+	struct b6b_obj *lists[3];
+	struct b6b_obj **fds;
+	struct b6b_lhead spare;
+	int nevs;
+	int nfds;
+	int fd;
+	int busy;
+};
+
+int b6b_epoll_wait(struct b6b_interp *interp,
+                   const int epfd,
+                   struct epoll_event *evs,
+                   const int n,
+                   const int timeout,
+                   int *ret)
 {
-	struct epoll_event ev = {0}, *evs;
-	struct b6b_obj *fds[3], *p, *op, *n, *t, *l, *fd;
-	int i, j = 0, out, err, r, w, e, ret;
-	unsigned int argc;
+	/* if the call doesn't block or there are no other threads to run, there's
+	 * no point in offloading it */
+	if ((timeout == 0) || !b6b_threaded(interp)) {
+		*ret = epoll_wait(epfd, evs, n, timeout);
+		return 1;
+	}
 
-	argc = b6b_proc_get_args(interp, args, "osi|i", &p, &op, &n, &t);
-	if (!argc || (n->i > INT_MAX))
-		return B6B_ERR;
+	/* if possible, wait until there are events through io_uring, then
+	 * receive them without blocking */
+	if (b6b_uring_poll(interp, epfd, POLLIN, timeout, ret)) {
+		*ret = epoll_wait(epfd, evs, n, 0);
+		return 1;
+	}
 
-	if ((argc == 3) && (strcmp(op->s, "remove") == 0)) {
-		if (n->i < 0)
-			return B6B_ERR;
+	return b6b_syscall(interp,
+	                   ret,
+#ifdef __NR_epoll_wait
+	                   __NR_epoll_wait,
+#else
+	                   __NR_epoll_pwait,
+#endif
+	                   (long)epfd,
+	                   (long)(intptr_t)evs,
+	                   (long)n,
+#ifdef __NR_epoll_wait
+	                   (long)timeout);
+#else
+	                   (long)timeout,
+	                   (long)(intptr_t)NULL);
+#endif
+}
 
-		if ((epoll_ctl((int)(intptr_t)p->priv,
-		               EPOLL_CTL_DEL,
-		               (int)n->i,
-		               NULL) < 0) &&
-		    (errno != ENOENT))
-			return b6b_return_strerror(interp, errno);
+/* returns a cached integer object that holds a fd, so ready fds don't need a
+ * new object each time */
+static struct b6b_obj *b6b_poll_fd(struct b6b_poll *poll, const int fd)
+{
+	struct b6b_obj **fds, *o;
+	int i, nfds;
 
-		return B6B_OK;
+	if (fd >= poll->nfds) {
+		nfds = poll->nfds ? poll->nfds : 16;
+		while (nfds <= fd)
+			nfds *= 2;
 
-	} else if (argc == 4) {
-		if (strcmp(op->s, "add") == 0) {
-			if (n->i < 0)
-				return B6B_ERR;
+		fds = (struct b6b_obj **)realloc(poll->fds, sizeof(*fds) * nfds);
+		if (!b6b_allocated(fds))
+			return NULL;
 
-			ev.events = ((int)t->i & (EPOLLIN | EPOLLOUT));
-			ev.data.fd = (int)n->i;
+		for (i = poll->nfds; i < nfds; ++i)
+			fds[i] = NULL;
 
-			if ((epoll_ctl((int)(intptr_t)p->priv,
-			               EPOLL_CTL_ADD,
-			               ev.data.fd,
-			               &ev) < 0) &&
-			    (errno != EEXIST))
-				return b6b_return_strerror(interp, errno);
+		poll->fds = fds;
+		poll->nfds = nfds;
+	}
 
-			return B6B_OK;
-		} else if (strcmp(op->s, "wait") == 0) {
-			if ((n->i <= 0) || (t->i < INT_MIN) || (t->i > INT_MAX))
-				return B6B_ERR;
+	o = poll->fds[fd];
 
-			l = b6b_list_new();
-			if (b6b_unlikely(!l))
-				return B6B_ERR;
+	/* the object may have been converted to a list and modified */
+	if (o && (!(o->flags & B6B_TYPE_INT) || (o->i != (b6b_int)fd))) {
+		b6b_unref(o);
+		o = poll->fds[fd] = NULL;
+	}
+
+	if (!o) {
+		o = b6b_int_new((b6b_int)fd);
+		if (b6b_unlikely(!o))
+			return NULL;
+
+		poll->fds[fd] = o;
+	}
+
+	return o;
+}
+
+/* appends an object to a list, using a recycled list item if possible */
+static int b6b_poll_add(struct b6b_poll *poll,
+                        struct b6b_obj *l,
+                        struct b6b_obj *o)
+{
+	struct b6b_litem *li;
 
-			for (i = 0; i < 3; ++i) {
-				fds[i] = b6b_list_new();
-				if (b6b_unlikely(!fds[i])) {
-					for (i -= 1; i >= 0; --i)
-						b6b_destroy(fds[i]);
+	li = TAILQ_FIRST(&poll->spare);
+	if (!li)
+		return b6b_list_add(l, o);
 
-					b6b_destroy(l);
-					return B6B_ERR;
-				}
+	TAILQ_REMOVE(&poll->spare, li, ents);
+	li->o = b6b_ref(o);
+	TAILQ_INSERT_TAIL(&l->l, li, ents);
+	b6b_list_flush(l);
+	return 1;
+}
 
-				if (b6b_unlikely(!b6b_list_add(l, fds[i]))) {
-					for (; i >= 0; --i)
-						b6b_destroy(fds[i]);
+/* empties a list and keeps its items for reuse */
+static void b6b_poll_clear(struct b6b_poll *poll, struct b6b_obj *l)
+{
+	struct b6b_litem *li, *tli;
 
-					b6b_destroy(l);
-					return B6B_ERR;
-				}
+	b6b_list_foreach_safe(l, li, tli) {
+		b6b_list_remove(l, li);
+		b6b_unref(li->o);
+		TAILQ_INSERT_TAIL(&poll->spare, li, ents);
+	}
+
+	b6b_list_flush(l);
+}
+
+static void b6b_poll_release(struct b6b_poll *poll)
+{
+	if (poll->res) {
+		b6b_unref(poll->res);
+		poll->res = NULL;
+	}
+}
 
-				/* l still holds a reference */
-				b6b_unref(fds[i]);
+/* returns a list of three empty lists: if the previous result is no longer
+ * used, it's reused */
+static struct b6b_obj *b6b_poll_res(struct b6b_poll *poll)
+{
+	struct b6b_litem *li;
+	int i;
+
+	if (poll->res) {
+		if (poll->res->refc == 1) {
+			i = 0;
+			b6b_list_foreach(poll->res, li) {
+				if ((i == 3) ||
+				    (li->o != poll->lists[i]) ||
+				    (li->o->refc != 1))
+					break;
+
+				++i;
 			}
 
-			evs = (struct epoll_event *)malloc(
-			                                 sizeof(struct epoll_event) * n->i);
-			if (!b6b_allocated(evs)) {
-				b6b_destroy(l);
-				return B6B_ERR;
+			if (!li && (i == 3)) {
+				for (i = 0; i < 3; ++i)
+					b6b_poll_clear(poll, poll->lists[i]);
+
+				b6b_list_flush(poll->res);
+				return poll->res;
 			}
+		}
 
-			/* p may be freed during context switch but although n or t may lose
-			 * their integer representation, we pass n->i and t->i by value so
-			 * this is safe */
-			b6b_ref(p);
+		b6b_poll_release(poll);
+	}
 
-			out = b6b_syscall(interp,
-			                  &ret,
-#ifdef __NR_epoll_wait
-			                  __NR_epoll_wait,
-#else
-			                  __NR_epoll_pwait,
-#endif
-			                  (long)(intptr_t)p->priv,
-			                  (long)(intptr_t)evs,
-			                  (long)n->i,
-#ifdef __NR_epoll_wait
-			                  (long)t->i);
-#else
-			                  (long)t->i,
-			                  (long)(intptr_t)NULL);
-#endif
+	poll->res = b6b_list_new();
+	if (b6b_unlikely(!poll->res))
+		return NULL;
 
-			b6b_unref(p);
+	for (i = 0; i < 3; ++i) {
+		poll->lists[i] = b6b_list_new();
+		if (b6b_unlikely(!poll->lists[i])) {
+			b6b_poll_release(poll);
+			return NULL;
+		}
+
+		if (b6b_unlikely(!b6b_list_add(poll->res, poll->lists[i]))) {
+			b6b_destroy(poll->lists[i]);
+			b6b_poll_release(poll);
+			return NULL;
+		}
+
+		/* the result still holds a reference */
+		b6b_unref(poll->lists[i]);
+	}
+
+	return poll->res;
+}
 
-			if (!out) {
-				free(evs);
-				b6b_destroy(l);
+static enum b6b_res b6b_poll_wait(struct b6b_interp *interp,
+                                  struct b6b_obj *p,
+                                  const int n,
+                                  const int t)
+{
+	struct b6b_poll *poll = (struct b6b_poll *)p->priv;
+	struct epoll_event *evs;
+	struct b6b_obj *l, *fd;
+	enum b6b_res res = B6B_ERR;
+	int i, out, err, ret, own = 0;
+
+	if (poll->busy) {
+		/* another thread waits for events and uses the buffer */
+		evs = (struct epoll_event *)malloc(sizeof(struct epoll_event) * n);
+		if (!b6b_allocated(evs))
+			return B6B_ERR;
+
+		own = 1;
+	} else {
+		if (n > poll->nevs) {
+			evs = (struct epoll_event *)realloc(
+			                                  poll->evs,
+			                                  sizeof(struct epoll_event) * n);
+			if (!b6b_allocated(evs))
 				return B6B_ERR;
-			}
 
-			if (ret < 0) {
-				err = errno;
-				free(evs);
-				b6b_destroy(l);
-				return b6b_return_strerror(interp, err);
-			}
+			poll->evs = evs;
+			poll->nevs = n;
+		}
+
+		evs = poll->evs;
+		poll->busy = 1;
+	}
+
+	/* p may be freed during context switch */
+	b6b_ref(p);
+	out = b6b_epoll_wait(interp, poll->fd, evs, n, t, &ret);
+	err = errno;
 
-			for (i = 0; (j < ret) && (i < n->i); ++i) {
-				if (!evs[i].events)
-					continue;
+	if (!own)
+		poll->busy = 0;
 
-				r = w = e = 0;
+	if (!out)
+		goto out;
 
-				if (evs[i].events & EPOLLIN)
-					r = 1;
+	if (ret < 0) {
+		res = b6b_return_strerror(interp, err);
+		goto out;
+	}
+
+	l = b6b_poll_res(poll);
+	if (b6b_unlikely(!l))
+		goto out;
+
+	for (i = 0; i < ret; ++i) {
+		if (!(evs[i].events &
+		      (EPOLLIN | EPOLLOUT | EPOLLERR | EPOLLHUP | EPOLLRDHUP)))
+			continue;
+
+		fd = b6b_poll_fd(poll, evs[i].data.fd);
+		if (b6b_unlikely(!fd))
+			goto out;
+
+		if (((evs[i].events & EPOLLIN) &&
+		     b6b_unlikely(!b6b_poll_add(poll, poll->lists[0], fd))) ||
+		    ((evs[i].events & EPOLLOUT) &&
+		     b6b_unlikely(!b6b_poll_add(poll, poll->lists[1], fd))) ||
+		    ((evs[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) &&
+		     b6b_unlikely(!b6b_poll_add(poll, poll->lists[2], fd)))) {
+			/* don't return a partial result next time */
+			b6b_poll_release(poll);
+			goto out;
+		}
+	}
+
+	res = b6b_return(interp, b6b_ref(l));
 
-				if (evs[i].events & EPOLLOUT)
-					w = 1;
+out:
+	if (own)
+		free(evs);
+
+	b6b_unref(p);
+	return res;
+}
+
+static enum b6b_res b6b_poll_proc(struct b6b_interp *interp,
+                                  struct b6b_obj *args)
+{
+	struct epoll_event ev = {0};
+	struct b6b_obj *p, *op, *n, *t;
+	struct b6b_poll *poll;
+	unsigned int argc;
 
-				if (evs[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP))
-					e = 1;
+	argc = b6b_proc_get_args(interp, args, "osi|i", &p, &op, &n, &t);
+	if (!argc || (n->i > INT_MAX))
+		return B6B_ERR;
 
-				if (r || w || e) {
-					fd = b6b_int_new((b6b_int)evs[i].data.fd);
-					if (b6b_unlikely(!fd))
-						goto err;
+	poll = (struct b6b_poll *)p->priv;
 
-					if ((r && b6b_unlikely(!b6b_list_add(fds[0], fd))) ||
-						(w && b6b_unlikely(!b6b_list_add(fds[1], fd))) ||
-						(e && b6b_unlikely(!b6b_list_add(fds[2], fd)))) {
-						b6b_destroy(fd);
-						goto err;
-					}
+	if ((argc == 3) && (strcmp(op->s, "remove") == 0)) {
+		if (n->i < 0)
+			return B6B_ERR;
 
-					b6b_unref(fd);
-					++j;
-				}
+		if ((epoll_ctl(poll->fd, EPOLL_CTL_DEL, (int)n->i, NULL) < 0) &&
+		    (errno != ENOENT))
+			return b6b_return_strerror(interp, errno);
 
-				continue;
+		return B6B_OK;
 
-err:
-				free(evs);
-				b6b_destroy(l);
+	} else if (argc == 4) {
+		if (strcmp(op->s, "add") == 0) {
+			if (n->i < 0)
 				return B6B_ERR;
-			}
 
-			free(evs);
-			return b6b_return(interp, l);
+			ev.events = ((int)t->i & B6B_POLL_EVENTS);
+			ev.data.fd = (int)n->i;
+
+			if ((epoll_ctl(poll->fd, EPOLL_CTL_ADD, ev.data.fd, &ev) < 0) &&
+			    (errno != EEXIST))
+				return b6b_return_strerror(interp, errno);
+
+			return B6B_OK;
+		} else if (strcmp(op->s, "mod") == 0) {
+			if (n->i < 0)
+				return B6B_ERR;
+
+			/* changes the events of a registered fd in one syscall, or re-arms
+			 * it if it's registered with POLLONESHOT */
+			ev.events = ((int)t->i & B6B_POLL_EVENTS);
+			ev.data.fd = (int)n->i;
+
+			if (epoll_ctl(poll->fd, EPOLL_CTL_MOD, ev.data.fd, &ev) < 0)
+				return b6b_return_strerror(interp, errno);
+
+			return B6B_OK;
+		} else if (strcmp(op->s, "wait") == 0) {
+			if ((n->i <= 0) || (t->i < INT_MIN) || (t->i > INT_MAX))
+				return B6B_ERR;
+
+			/* although n or t may lose their integer representation during
+			 * context switch, we pass n->i and t->i by value so this is
+			 * safe */
+			return b6b_poll_wait(interp, p, (int)n->i, (int)t->i);
 		}
 	}
 
@@ -191,30 +370,64 @@ err:
 
 static void b6b_poll_del(void *priv)
 {
-	close((int)(intptr_t)priv);
+	struct b6b_poll *poll = (struct b6b_poll *)priv;
+	struct b6b_litem *li;
+	int i;
+
+	b6b_poll_release(poll);
+
+	while ((li = TAILQ_FIRST(&poll->spare))) {
+		TAILQ_REMOVE(&poll->spare, li, ents);
+		free(li);
+	}
+
+	for (i = 0; i < poll->nfds; ++i) {
+		if (poll->fds[i])
+			b6b_unref(poll->fds[i]);
+	}
+
+	free(poll->fds);
+	free(poll->evs);
+	close(poll->fd);
+	free(poll);
 }
 
 static enum b6b_res b6b_poll_proc_poll(struct b6b_interp *interp,
                                        struct b6b_obj *args)
 {
 	struct b6b_obj *o;
-	int fd;
+	struct b6b_poll *poll;
 
 	if (!b6b_proc_get_args(interp, args, "o", NULL))
 		return B6B_ERR;
 
-	fd = epoll_create1(EPOLL_CLOEXEC);
-	if (fd < 0)
+	poll = (struct b6b_poll *)malloc(sizeof(*poll));
+	if (!b6b_allocated(poll))
+		return B6B_ERR;
+
+	poll->fd = epoll_create1(EPOLL_CLOEXEC);
+	if (poll->fd < 0) {
+		free(poll);
 		return b6b_return_strerror(interp, errno);
+	}
 
-	o = b6b_str_fmt("poll:%d", fd);
+	o = b6b_str_fmt("poll:%d", poll->fd);
 	if (b6b_unlikely(!o)) {
-		close(fd);
+		close(poll->fd);
+		free(poll);
 		return B6B_ERR;
 	}
 
+	poll->evs = NULL;
+	poll->res = NULL;
+	poll->fds = NULL;
+	TAILQ_INIT(&poll->spare);
+	poll->nevs = 0;
+	poll->nfds = 0;
+	poll->busy = 0;
+
 	o->proc = b6b_poll_proc;
-	o->priv = (void *)(intptr_t)fd;
+	o->priv = poll;
 	o->del = b6b_poll_del;
 
 	return b6b_return(interp, o);
@@ -242,5 +455,20 @@ static const struct b6b_ext_obj b6b_poll[] = {
 		.type = B6B_TYPE_INT,
 		.val.i = EPOLLIN | EPOLLOUT
 	},
+	{
+		.name = "POLLRDHUP",
+		.type = B6B_TYPE_INT,
+		.val.i = EPOLLRDHUP
+	},
+	{
+		.name = "POLLET",
+		.type = B6B_TYPE_INT,
+		.val.i = EPOLLET
+	},
+	{
+		.name = "POLLONESHOT",
+		.type = B6B_TYPE_INT,
+		.val.i = EPOLLONESHOT
+	},
 };
 __b6b_ext(b6b_poll);
@@ -0,0 +1,271 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2026 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+
+#include <b6b.h>
+
+#define B6B_REACTOR_MAX_EVENTS 64
+
+static int b6b_reactor_open(struct b6b_interp *interp)
+{
+	struct b6b_reactor *r = &interp->reactor;
+#if defined(B6B_HAVE_OFFLOAD_THREAD) || defined(B6B_HAVE_IO_URING)
+	struct epoll_event ev;
+#endif
+
+	if (r->epfd < 0) {
+		r->epfd = epoll_create1(EPOLL_CLOEXEC);
+		if (r->epfd < 0)
+			return 0;
+	}
+
+#ifdef B6B_HAVE_OFFLOAD_THREAD
+	/* offload threads signal an eventfd when a job is done and the
+	 * interpreter thread is waiting, so epoll_wait() should return when it's
+	 * readable; the eventfd is created on first use, maybe after the
+	 * reactor */
+	if ((r->offfd < 0) && (interp->offpool.efd >= 0)) {
+		ev.events = EPOLLIN;
+		ev.data.ptr = NULL;
+		if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, interp->offpool.efd, &ev) < 0)
+			return 0;
+
+		r->offfd = interp->offpool.efd;
+	}
+#endif
+
+#ifdef B6B_HAVE_IO_URING
+	/* the io_uring file descriptor is readable when an operation is done */
+	if ((r->ringfd < 0) && (interp->uring.fd >= 0)) {
+		ev.events = EPOLLIN;
+		ev.data.ptr = NULL;
+		if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, interp->uring.fd, &ev) < 0)
+			return 0;
+
+		r->ringfd = interp->uring.fd;
+	}
+#endif
+
+	return 1;
+}
+
+void b6b_reactor_destroy(struct b6b_reactor *r)
+{
+	int i;
+
+	for (i = 0; i < r->nfds; ++i)
+		free(r->fds[i]);
+
+	free(r->fds);
+
+	if (r->epfd >= 0)
+		close(r->epfd);
+}
+
+static struct b6b_io_fd *b6b_io_fd_get(struct b6b_reactor *r, const int fd)
+{
+	struct b6b_io_fd **fds, *f;
+	int nfds;
+
+	if (fd >= r->nfds) {
+		nfds = r->nfds ? r->nfds : 16;
+		while (nfds <= fd) {
+			if (nfds > INT_MAX / 2)
+				return NULL;
+
+			nfds *= 2;
+		}
+
+		fds = (struct b6b_io_fd **)realloc(r->fds, sizeof(*fds) * nfds);
+		if (b6b_unlikely(!fds))
+			return NULL;
+
+		memset(&fds[r->nfds], 0, sizeof(*fds) * (nfds - r->nfds));
+		r->fds = fds;
+		r->nfds = nfds;
+	}
+
+	f = r->fds[fd];
+	if (!f) {
+		f = (struct b6b_io_fd *)malloc(sizeof(*f));
+		if (b6b_unlikely(!f))
+			return NULL;
+
+		b6b_waitq_init(&f->in);
+		b6b_waitq_init(&f->out);
+		f->events = 0;
+		f->fd = fd;
+		r->fds[fd] = f;
+	}
+
+	return f;
+}
+
+/* registers fd with the events its waiters wait for, or unregisters it if
+ * there are no waiters */
+static int b6b_io_fd_update(struct b6b_reactor *r, struct b6b_io_fd *f)
+{
+	struct epoll_event ev;
+
+	ev.events = 0;
+	if (!TAILQ_EMPTY(&f->in))
+		ev.events |= EPOLLIN | EPOLLRDHUP;
+	if (!TAILQ_EMPTY(&f->out))
+		ev.events |= EPOLLOUT;
+	ev.data.ptr = f;
+
+	if (ev.events == f->events)
+		return 1;
+
+	if (!ev.events) {
+		epoll_ctl(r->epfd, EPOLL_CTL_DEL, f->fd, NULL);
+		f->events = 0;
+		return 1;
+	}
+
+	/* if fd was closed, it's no longer registered */
+	if (!f->events || (epoll_ctl(r->epfd, EPOLL_CTL_MOD, f->fd, &ev) < 0)) {
+		if ((f->events && (errno != ENOENT)) ||
+		    (epoll_ctl(r->epfd, EPOLL_CTL_ADD, f->fd, &ev) < 0))
+			return 0;
+	}
+
+	f->events = ev.events;
+	return 1;
+}
+
+/* wakes up all threads in q that are still parked */
+static void b6b_io_wake(struct b6b_interp *interp, struct b6b_waitq *q)
+{
+	struct b6b_waiter *w;
+
+	while ((w = TAILQ_FIRST(q))) {
+		TAILQ_REMOVE(q, w, ents);
+		w->queued = 0;
+
+		/* a thread that waits for both events may have been woken up
+		 * already */
+		if (b6b_thread_parked(w->t)) {
+			b6b_thread_dequeue(&interp->reactor.waiting, w->t);
+			b6b_wake(interp, w->t);
+		}
+	}
+}
+
+int b6b_io_wait(struct b6b_interp *interp,
+                const int fd,
+                const unsigned int events)
+{
+	struct b6b_waiter in, out;
+	struct b6b_thread *t = interp->fg;
+	struct b6b_io_fd *f;
+	int ret;
+
+	/* the main thread may be running an event loop, so it never parks */
+	if ((t == b6b_thread_first(&interp->threads)) ||
+	    interp->exit ||
+	    (fd < 0) ||
+	    !b6b_reactor_open(interp))
+		return 0;
+
+	f = b6b_io_fd_get(&interp->reactor, fd);
+	if (!f)
+		return 0;
+
+	/* other threads may wait for the same file descriptor, e.g. one reads
+	 * from a socket while another writes to it */
+	in.queued = 0;
+	out.queued = 0;
+	if (events & B6B_IO_IN)
+		b6b_waitq_add(&f->in, &in, t);
+	if (events & B6B_IO_OUT)
+		b6b_waitq_add(&f->out, &out, t);
+
+	/* fails if fd doesn't support polling (e.g. a regular file), so the caller
+	 * doesn't block */
+	if (!b6b_io_fd_update(&interp->reactor, f)) {
+		b6b_waitq_del(&f->in, &in);
+		b6b_waitq_del(&f->out, &out);
+		return 0;
+	}
+
+	b6b_thread_enqueue(&interp->reactor.waiting, t);
+	ret = b6b_park(interp);
+	if (!ret)
+		b6b_thread_dequeue(&interp->reactor.waiting, t);
+
+	/* if we were woken up by b6b_join(), we're still queued */
+	b6b_waitq_del(&f->in, &in);
+	b6b_waitq_del(&f->out, &out);
+	b6b_io_fd_update(&interp->reactor, f);
+
+	/* if the interpreter is exiting, we were woken up by b6b_join() */
+	return ret && !interp->exit;
+}
+
+int b6b_io_poll(struct b6b_interp *interp, const int timeout)
+{
+	struct epoll_event evs[B6B_REACTOR_MAX_EVENTS];
+	struct b6b_io_fd *f;
+	int i, n;
+
+	/* the reactor may be used only as a timer, before any thread waited for a
+	 * file descriptor */
+	if (!b6b_reactor_open(interp))
+		return -1;
+
+	n = epoll_wait(interp->reactor.epfd,
+	               evs,
+	               sizeof(evs) / sizeof(evs[0]),
+	               timeout);
+	if (n < 0)
+		return (errno == EINTR) ? 0 : -1;
+
+	for (i = 0; i < n; ++i) {
+		f = (struct b6b_io_fd *)evs[i].data.ptr;
+
+#ifdef B6B_HAVE_OFFLOAD_THREAD
+		/* reset the eventfd signaled by offload threads, so it doesn't stay
+		 * readable; io_uring completions are reaped by the scheduler */
+		if (!f) {
+			b6b_offload_drain(&interp->offpool);
+			continue;
+		}
+#else
+		if (!f)
+			continue;
+#endif
+
+		if (evs[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+			b6b_io_wake(interp, &f->in);
+		if (evs[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+			b6b_io_wake(interp, &f->out);
+
+		/* stop watching for events nobody waits for anymore, so fd is not
+		 * reported again before the woken threads run */
+		b6b_io_fd_update(&interp->reactor, f);
+	}
+
+	return n;
+}
@@ -32,6 +32,8 @@
 #include <b6b.h>
 
 #define B6B_SERVER_DEF_BACKLOG 5
+/* the default timeout of name resolution, in nanoseconds */
+#define B6B_SOCKET_RESOLVE_TIMEOUT (30 * (uint64_t)1000000000)
 
 struct b6b_socket {
 	struct sockaddr_storage peer;
@@ -276,75 +278,104 @@ static void b6b_socket_do_getaddrinfo(void *arg)
 	                        &data->res);
 }
 
+static void b6b_socket_gai_free(void *arg)
+{
+	struct b6b_socket_gai_data *data = (struct b6b_socket_gai_data *)arg;
+
+	if (data->res)
+		freeaddrinfo(data->res);
+
+	free(data->service);
+	free(data->host);
+	free(data);
+}
+
 static struct addrinfo *b6b_socket_resolve(struct b6b_interp *interp,
                                            struct b6b_obj *host,
                                            struct b6b_obj *service,
-                                           const int socktype)
+                                           const int socktype,
+                                           const uint64_t timeout)
 {
-	struct b6b_socket_gai_data data = {
-		.hints = {
-			.ai_flags = AI_ADDRCONFIG | AI_V4MAPPED,
-			.ai_family = AF_UNSPEC
-		},
-		.host = NULL,
-		.service = NULL
-	};
+	struct b6b_socket_gai_data *data;
+	struct addrinfo *res;
 	const char *s;
-	int out;
+
+	/* the data must outlive this call if getaddrinfo() times out */
+	data = (struct b6b_socket_gai_data *)calloc(1, sizeof(*data));
+	if (!b6b_allocated(data))
+		return NULL;
+
+	data->hints.ai_flags = AI_ADDRCONFIG | AI_V4MAPPED;
+	data->hints.ai_family = AF_UNSPEC;
 
 	/* both strings must be copied since they may be freed during
-	 * b6b_offload() */
+	 * b6b_offload_timeout() */
 	if (host->slen) {
-		data.host = b6b_strndup(host->s, host->slen);
-		if (b6b_unlikely(!data.host))
+		data->host = b6b_strndup(host->s, host->slen);
+		if (b6b_unlikely(!data->host)) {
+			b6b_socket_gai_free(data);
 			return NULL;
+		}
 	} else
-		data.hints.ai_flags |= AI_PASSIVE;
+		data->hints.ai_flags |= AI_PASSIVE;
 
 	if (service) {
-		data.service = b6b_strndup(service->s, service->slen);
-		if (b6b_unlikely(!data.service)) {
-			free(data.host);
+		data->service = b6b_strndup(service->s, service->slen);
+		if (b6b_unlikely(!data->service)) {
+			b6b_socket_gai_free(data);
 			return NULL;
 		}
 	}
 
-	data.hints.ai_socktype = socktype;
-	out = b6b_offload(interp, b6b_socket_do_getaddrinfo, &data);
-
-	free(data.service);
-	free(data.host);
-
-	if (!out) {
-		if (data.res)
-			freeaddrinfo(data.res);
+	data->hints.ai_socktype = socktype;
+	if (!b6b_offload_timeout(interp,
+	                         b6b_socket_do_getaddrinfo,
+	                         data,
+	                         b6b_socket_gai_free,
+	                         timeout))
 		return NULL;
-	}
 
-	if (data.out == 0)
-		return data.res;
+	if (data->out == 0) {
+		res = data->res;
+		data->res = NULL;
+		b6b_socket_gai_free(data);
+		return res;
+	}
 
-	s = gai_strerror(data.out);
+	s = gai_strerror(data->out);
 	if (s)
 		b6b_return_str(interp, s, strlen(s));
 
+	b6b_socket_gai_free(data);
 	return NULL;
 }
 
 static enum b6b_res b6b_socket_proc_nslookup(struct b6b_interp *interp,
                                              struct b6b_obj *args)
 {
-	struct b6b_obj *h, *l, *o;
+	struct b6b_obj *h, *to, *l, *o;
 	struct addrinfo *res, *resp;
+	uint64_t timeout = B6B_SOCKET_RESOLVE_TIMEOUT;
 
-	if (!b6b_proc_get_args(interp, args, "os", NULL, &h))
-		return B6B_ERR;
+	switch (b6b_proc_get_args(interp, args, "os|f", NULL, &h, &to)) {
+		case 3:
+			if ((to->f <= 0) || (to->f > UINT_MAX))
+				return B6B_ERR;
+
+			timeout = (uint64_t)(to->f * 1000000000);
+
+		case 2:
+			break;
+
+		default:
+			return B6B_ERR;
+	}
 
 	l = b6b_list_new();
 	if (!b6b_allocated(l))
 		return B6B_ERR;
 
-	res = b6b_socket_resolve(interp, h, NULL, SOCK_DGRAM);
+	res = b6b_socket_resolve(interp, h, NULL, SOCK_DGRAM, timeout);
 	if (!res) {
 		b6b_destroy(l);
 		return B6B_ERR;
@@ -437,10 +468,18 @@ static enum b6b_res b6b_socket_proc_inet_client(struct b6b_interp *interp,
 		return B6B_ERR;
 
 	if (strcmp(t->s, "udp") == 0) {
-		res = b6b_socket_resolve(interp, h, s, SOCK_DGRAM);
+		res = b6b_socket_resolve(interp,
+		                          h,
+		                          s,
+		                          SOCK_DGRAM,
+		                          B6B_SOCKET_RESOLVE_TIMEOUT);
 		ops = &b6b_udp_client_ops;
 	} else if (strcmp(t->s, "tcp") == 0)
-		res = b6b_socket_resolve(interp, h, s, SOCK_STREAM);
+		res = b6b_socket_resolve(interp,
+		                          h,
+		                          s,
+		                          SOCK_STREAM,
+		                          B6B_SOCKET_RESOLVE_TIMEOUT);
 	else
 		return B6B_ERR;
 
@@ -637,12 +676,20 @@ static enum b6b_res b6b_socket_proc_inet_server(struct b6b_interp *interp,
 		return B6B_ERR;
 
 	if ((argc == 4) && (strcmp(t->s, "udp") == 0))
-		res = b6b_socket_resolve(interp, h, s, SOCK_DGRAM);
+		res = b6b_socket_resolve(interp,
+		                          h,
+		                          s,
+		                          SOCK_DGRAM,
+		                          B6B_SOCKET_RESOLVE_TIMEOUT);
 	else if (strcmp(t->s, "tcp") == 0) {
 		if (argc == 5)
 			backlog = b->i;
 
-		res = b6b_socket_resolve(interp, h, s, SOCK_STREAM);
+		res = b6b_socket_resolve(interp,
+		                          h,
+		                          s,
+		                          SOCK_STREAM,
+		                          B6B_SOCKET_RESOLVE_TIMEOUT);
 	}
 	else
 		return B6B_ERR;
@@ -20,7 +20,6 @@
 #include <string.h>
 #include <stdio.h>
 #include <limits.h>
-#include <wchar.h>
 
 #include <b6b.h>
 
@@ -264,43 +263,44 @@ int b6b_as_str(struct b6b_obj *o)
 
 struct b6b_obj *b6b_str_decode(const char *s, size_t len)
 {
-	mbstate_t ps = {0};
 	struct b6b_obj *l, *c;
 	size_t out;
+	int ascii;
+
+	/* validate the entire string first, so we can split it into characters
+	 * without decoding each one; strings that contain \0 cannot be
+	 * decoded */
+	if (memchr(s, '\0', len) || !b6b_utf8_validate(s, len, &ascii))
+		return NULL;
 
 	l = b6b_list_new();
 	if (b6b_unlikely(!l))
-		return 0;
+		return NULL;
 
-	if (len) {
-		do {
-			out = mbrtowc(NULL, s, len, &ps);
-			if ((out == 0) || (out == (size_t)-1) || (out == (size_t)-2)) {
-				b6b_destroy(l);
-				return NULL;
-			}
+	while (len) {
+		out = ascii ? 1 : b6b_utf8_cplen((unsigned char)*s);
 
-			c = b6b_str_copy(s, out);
-			if (b6b_unlikely(!c)) {
-				b6b_destroy(l);
-				return NULL;
-			}
+		c = b6b_str_copy(s, out);
+		if (b6b_unlikely(!c)) {
+			b6b_destroy(l);
+			return NULL;
+		}
 
-			if (b6b_unlikely(!b6b_list_add(l, c))) {
-				b6b_destroy(c);
-				b6b_destroy(l);
-				return NULL;
-			}
+		if (out == 1)
+			c->flags |= B6B_STR_UTF8 | B6B_STR_ASCII;
+		else
+			c->flags |= B6B_STR_UTF8;
 
-			b6b_unref(c);
+		if (b6b_unlikely(!b6b_list_add(l, c))) {
+			b6b_destroy(c);
+			b6b_destroy(l);
+			return NULL;
+		}
 
-			len -= out;
-			/* if the entire string was converted, stop */
-			if (!len)
-				break;
+		b6b_unref(c);
 
-			s += out;
-		} while (1);
+		s += out;
+		len -= out;
 	}
 
 	return l;
@@ -358,8 +358,8 @@ static enum b6b_res b6b_str_proc_join(struct b6b_interp *interp,
 {
 	struct b6b_obj *d, *l, *o;
 	struct b6b_litem *li;
-	char *s = NULL, *ms;
-	size_t len = 0, mlen;
+	char *s, *p;
+	size_t len = 0;
 
 	if (!b6b_proc_get_args(interp, args, "osl", NULL, &d, &l))
 		return B6B_ERR;
@@ -368,35 +368,279 @@ static enum b6b_res b6b_str_proc_join(struct b6b_interp *interp,
 	if (!li)
 		return b6b_return_str(interp, "", 0);
 
-	if (!b6b_as_str(li->o))
-		return B6B_ERR;
+	/* calculate the output length first, so we allocate the output buffer
+	 * once instead of growing it with each item */
+	b6b_list_foreach(l, li) {
+		if (!b6b_as_str(li->o) ||
+		    (li->o->slen > SIZE_MAX - 1 - len - d->slen))
+			return B6B_ERR;
+
+		len += li->o->slen + d->slen;
+	}
+	len -= d->slen;
 
-	len = li->o->slen;
 	s = (char *)malloc(len + 1);
 	if (!b6b_allocated(s))
 		return B6B_ERR;
 
+	li = b6b_list_first(l);
 	memcpy(s, li->o->s, li->o->slen);
+	p = s + li->o->slen;
 
 	for (li = b6b_list_next(li); li; li = b6b_list_next(li)) {
-		if (!b6b_as_str(li->o)) {
-			free(s);
+		memcpy(p, d->s, d->slen);
+		p += d->slen;
+		memcpy(p, li->o->s, li->o->slen);
+		p += li->o->slen;
+	}
+
+	s[len] = '\0';
+	o = b6b_str_new(s, len);
+	if (b6b_unlikely(!o)) {
+		free(s);
+		return B6B_ERR;
+	}
+
+	return b6b_return(interp, o);
+}
+
+static enum b6b_res b6b_str_proc_concat(struct b6b_interp *interp,
+                                        struct b6b_obj *args)
+{
+	struct b6b_obj *o;
+	struct b6b_litem *first, *li;
+	char *s, *p;
+	size_t len = 0;
+
+	first = b6b_list_next(b6b_list_first(args));
+	for (li = first; li; li = b6b_list_next(li)) {
+		if (!b6b_as_str(li->o) || (li->o->slen > SIZE_MAX - 1 - len))
 			return B6B_ERR;
+
+		len += li->o->slen;
+	}
+
+	/* if there's only one string, we don't need a copy */
+	if (first && !b6b_list_next(first))
+		return b6b_return(interp, b6b_ref(first->o));
+
+	s = (char *)malloc(len + 1);
+	if (!b6b_allocated(s))
+		return B6B_ERR;
+
+	p = s;
+	for (li = first; li; li = b6b_list_next(li)) {
+		memcpy(p, li->o->s, li->o->slen);
+		p += li->o->slen;
+	}
+
+	s[len] = '\0';
+	o = b6b_str_new(s, len);
+	if (b6b_unlikely(!o)) {
+		free(s);
+		return B6B_ERR;
+	}
+
+	return b6b_return(interp, o);
+}
+
+enum b6b_fmt_seg_type {
+	B6B_FMT_SEG_LIT,
+	B6B_FMT_SEG_STR,
+	B6B_FMT_SEG_INT
+};
+
+struct b6b_fmt_seg {
+	size_t off;
+	size_t len;
+	enum b6b_fmt_seg_type type;
+};
+
+struct b6b_fmt {
+	struct b6b_cache cache;
+	unsigned int nsegs;
+	unsigned int nargs;
+	struct b6b_fmt_seg segs[];
+};
+
+static void b6b_fmt_del(void *priv)
+{
+	free(priv);
+}
+
+static struct b6b_fmt *b6b_fmt_parse(struct b6b_interp *interp,
+                                     const char *s,
+                                     const size_t len)
+{
+	struct b6b_fmt *fmt;
+	struct b6b_fmt_seg *seg;
+	const char *p = s, *end = s + len;
+	unsigned int max = 1;
+
+	/* each directive adds at most two segments: itself and the literal
+	 * following it */
+	while ((p < end) && (p = memchr(p, '%', end - p))) {
+		max += 2;
+		++p;
+	}
+
+	fmt = (struct b6b_fmt *)malloc(sizeof(*fmt) + sizeof(fmt->segs[0]) * max);
+	if (!b6b_allocated(fmt))
+		return NULL;
+
+	fmt->nsegs = 0;
+	fmt->nargs = 0;
+
+	for (p = s; p < end; ++p) {
+		seg = &fmt->segs[fmt->nsegs];
+
+		if (*p != '%') {
+			if (fmt->nsegs && (seg[-1].type == B6B_FMT_SEG_LIT) &&
+			    (seg[-1].off + seg[-1].len == (size_t)(p - s)))
+				++seg[-1].len;
+			else {
+				seg->off = p - s;
+				seg->len = 1;
+				seg->type = B6B_FMT_SEG_LIT;
+				++fmt->nsegs;
+			}
+
+			continue;
+		}
+
+		if (++p == end) {
+			free(fmt);
+			b6b_return_fmt(interp, "bad fmt: %s", s);
+			return NULL;
 		}
 
-		mlen = len + d->slen + li->o->slen;
+		switch (*p) {
+			case '%':
+				seg->off = p - s;
+				seg->len = 1;
+				seg->type = B6B_FMT_SEG_LIT;
+				break;
+
+			case 's':
+				seg->type = B6B_FMT_SEG_STR;
+				++fmt->nargs;
+				break;
+
+			case 'd':
+				seg->type = B6B_FMT_SEG_INT;
+				++fmt->nargs;
+				break;
 
-		ms = (char *)realloc(s, mlen + 1);
-		if (!b6b_allocated(ms)) {
-			free(s);
+			default:
+				free(fmt);
+				b6b_return_fmt(interp, "bad fmt: %s", s);
+				return NULL;
+		}
+
+		++fmt->nsegs;
+	}
+
+	return fmt;
+}
+
+static enum b6b_res b6b_str_proc_fmt(struct b6b_interp *interp,
+                                     struct b6b_obj *args)
+{
+	struct b6b_obj *f, *o;
+	struct b6b_litem *first, *li;
+	struct b6b_fmt *fmt;
+	const struct b6b_fmt_seg *seg, *end;
+	char *s, *p;
+	size_t len = 0, alen;
+	unsigned int argc;
+	int n;
+
+	argc = b6b_proc_get_args(interp, args, "os|*", NULL, &f, &first);
+	if (!argc)
+		return B6B_ERR;
+
+	/* the format is parsed once and cached on the format object, until its
+	 * string representation changes */
+	fmt = (struct b6b_fmt *)b6b_cache_get(f, b6b_fmt_del);
+	if (!fmt) {
+		fmt = b6b_fmt_parse(interp, f->s, f->slen);
+		if (!fmt)
 			return B6B_ERR;
+
+		b6b_cache_add(f, &fmt->cache, b6b_fmt_del);
+	}
+
+	if (argc == 2)
+		first = NULL;
+
+	end = fmt->segs + fmt->nsegs;
+
+	/* calculate the output length first, so we allocate it once */
+	li = first;
+	for (seg = fmt->segs; seg < end; ++seg) {
+		if (seg->type == B6B_FMT_SEG_LIT) {
+			alen = seg->len;
+		} else {
+			if (!li) {
+				b6b_return_fmt(interp, "too few args for fmt: %s", f->s);
+				return B6B_ERR;
+			}
+
+			if (seg->type == B6B_FMT_SEG_INT) {
+				if (!b6b_as_int(li->o))
+					return B6B_ERR;
+
+				n = snprintf(NULL, 0, "%lld", li->o->i);
+				if (b6b_unlikely(n < 0))
+					return B6B_ERR;
+
+				alen = (size_t)n;
+			} else {
+				if (!b6b_as_str(li->o))
+					return B6B_ERR;
+
+				alen = li->o->slen;
+			}
+
+			li = b6b_list_next(li);
 		}
 
-		memcpy(ms + len, d->s, d->slen);
-		memcpy(ms + len + d->slen, li->o->s, li->o->slen);
+		if (alen > SIZE_MAX - 1 - len)
+			return B6B_ERR;
+
+		len += alen;
+	}
 
-		s = ms;
-		len = mlen;
+	if (li) {
+		b6b_return_fmt(interp, "too many args for fmt: %s", f->s);
+		return B6B_ERR;
+	}
+
+	s = (char *)malloc(len + 1);
+	if (!b6b_allocated(s))
+		return B6B_ERR;
+
+	p = s;
+	li = first;
+	for (seg = fmt->segs; seg < end; ++seg) {
+		switch (seg->type) {
+			case B6B_FMT_SEG_LIT:
+				memcpy(p, f->s + seg->off, seg->len);
+				p += seg->len;
+				break;
+
+			case B6B_FMT_SEG_STR:
+				memcpy(p, li->o->s, li->o->slen);
+				p += li->o->slen;
+				li = b6b_list_next(li);
+				break;
+
+			case B6B_FMT_SEG_INT:
+				/* we reserved room for the terminating \0 */
+				p += snprintf(p, len + 1 - (p - s), "%lld", li->o->i);
+				li = b6b_list_next(li);
+				break;
+		}
 	}
 
 	s[len] = '\0';
@@ -714,6 +958,18 @@ static const struct b6b_ext_obj b6b_str[] = {
 		.val.s = "str.join",
 		.proc = b6b_str_proc_join
 	},
+	{
+		.name = "str.concat",
+		.type = B6B_TYPE_STR,
+		.val.s = "str.concat",
+		.proc = b6b_str_proc_concat
+	},
+	{
+		.name = "str.fmt",
+		.type = B6B_TYPE_STR,
+		.val.s = "str.fmt",
+		.proc = b6b_str_proc_fmt
+	},
 	{
 		.name = "str.split",
 		.type = B6B_TYPE_STR,
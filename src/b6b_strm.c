@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <poll.h>
 
 #include <b6b.h>
 
@@ -33,8 +34,12 @@ static void b6b_strm_close(struct b6b_strm *strm)
 
 static void b6b_strm_del(void *priv)
 {
-	b6b_strm_close((struct b6b_strm *)priv);
-	free(priv);
+	struct b6b_strm *strm = (struct b6b_strm *)priv;
+
+	b6b_strm_close(strm);
+	b6b_buf_free(&strm->rbuf);
+	free(strm->delim);
+	free(strm);
 }
 
 static int b6b_strm_peeksz(struct b6b_interp *interp,
@@ -54,53 +59,96 @@ static int b6b_strm_peeksz(struct b6b_interp *interp,
 	return 1;
 }
 
-static enum b6b_res b6b_strm_read(struct b6b_interp *interp,
-                                  struct b6b_strm *strm,
-                                  ssize_t want)
+/* in a spawned thread, parks the caller until the stream is ready instead of
+ * letting it poll a non-blocking stream */
+static int b6b_strm_wait(struct b6b_interp *interp,
+                         struct b6b_strm *strm,
+                         const unsigned int events)
 {
-	struct b6b_obj *o;
-	unsigned char *buf = NULL, *nbuf;
-	ssize_t len = 1, est, out = 0, more;
+	if ((strm->flags & B6B_STRM_CLOSED) || !strm->ops->fd)
+		return 0;
+
+	/* another thread may close the stream while we wait */
+	return b6b_io_wait(interp, strm->ops->fd(strm->priv), events) &&
+	       !(strm->flags & B6B_STRM_CLOSED);
+}
+
+/* checks whether a read would not block, without blocking */
+static int b6b_strm_ready(struct b6b_strm *strm)
+{
+	struct pollfd pfd = {.events = POLLIN};
+
+	if ((strm->flags & B6B_STRM_CLOSED) || !strm->ops->fd)
+		return 0;
+
+	pfd.fd = strm->ops->fd(strm->priv);
+	return (poll(&pfd, 1, 0) > 0) &&
+	       (pfd.revents & (POLLIN | POLLHUP | POLLERR));
+}
+
+/* a stream that's readable but has nothing to read has reached EOF */
+static int b6b_strm_eof(struct b6b_interp *interp, struct b6b_strm *strm)
+{
+	ssize_t est;
+
+	if (strm->flags & B6B_STRM_EOF)
+		return 1;
+
+	if (!b6b_strm_ready(strm) ||
+	    !b6b_strm_peeksz(interp, strm, &est) ||
+	    est)
+		return 0;
+
+	strm->flags |= B6B_STRM_EOF;
+	return 1;
+}
+
+/* appends up to want bytes to buf and returns the number of bytes read, or -1
+ * on error */
+static ssize_t b6b_strm_fill(struct b6b_interp *interp,
+                             struct b6b_strm *strm,
+                             struct b6b_buf *buf,
+                             ssize_t want)
+{
+	unsigned char *p;
+	ssize_t est, out = 0, more;
 	int eof = 0, again = 1;
 
 	if (strm->flags & B6B_STRM_EOF)
-		return B6B_OK;
+		return 0;
 
 	if ((strm->flags & B6B_STRM_CLOSED) || !strm->ops->read)
-		return B6B_ERR;
+		return -1;
 
 	/* try to estimate of the amount of incoming data, so we can read everything
 	 * in one pass if it's accurate */
 	if (!b6b_strm_peeksz(interp, strm, &est))
-		return B6B_ERR;
+		return -1;
 
-	if (est > want)
-		est = want;
+	/* if there's nothing to read yet, wait: if the stream is still empty after
+	 * that, we've reached EOF, unless another thread waited for the same
+	 * stream and read the data first */
+	while (!est && b6b_strm_wait(interp, strm, B6B_IO_IN)) {
+		if (!b6b_strm_peeksz(interp, strm, &est))
+			return -1;
 
-	do {
-		len += est;
+		if (!est && b6b_strm_ready(strm))
+			break;
+	}
 
-		nbuf = (unsigned char *)realloc(buf, len);
-		if (!b6b_allocated(nbuf)) {
-			free(buf);
-			return B6B_ERR;
-		}
+	if (est > want)
+		est = want;
 
-		buf = nbuf;
-		if (!est)
-			break;
+	while (est) {
+		p = b6b_buf_reserve(buf, (size_t)est);
+		if (b6b_unlikely(!p))
+			return -1;
 
-		more = strm->ops->read(interp,
-		                       strm->priv,
-		                       buf + out,
-		                       est,
-		                       &eof,
-		                       &again);
-		if (more < 0) {
-			free(buf);
-			return B6B_ERR;
-		}
+		more = strm->ops->read(interp, strm->priv, p, est, &eof, &again);
+		if (more < 0)
+			return -1;
 
+		b6b_buf_commit(buf, (size_t)more);
 		out += more;
 
 		if (eof) {
@@ -114,28 +162,215 @@ static enum b6b_res b6b_strm_read(struct b6b_interp *interp,
 		if (!want)
 			break;
 
-		if (!b6b_strm_peeksz(interp, strm, &est)) {
-			free(buf);
-			return B6B_ERR;
-		}
-
-		if (!est)
-			break;
+		if (!b6b_strm_peeksz(interp, strm, &est))
+			return -1;
 
 		if (est > want)
 			est = want;
+	}
+
+	return out;
+}
+
+/* data removed from the read buffer was already searched for the delimiter */
+static void b6b_strm_consume(struct b6b_strm *strm, const size_t len)
+{
+	strm->scan = (strm->scan > len) ? strm->scan - len : 0;
+}
+
+/* the read buffer may contain a different delimiter before the point where the
+ * search for the previous one should continue */
+static void b6b_strm_set_delim(struct b6b_strm *strm,
+                               const char *delim,
+                               const size_t dlen)
+{
+	char *copy;
+
+	if ((dlen == strm->dlen) && (memcmp(delim, strm->delim, dlen) == 0))
+		return;
+
+	strm->scan = 0;
+
+	copy = (char *)realloc(strm->delim, dlen);
+	if (b6b_unlikely(!copy)) {
+		/* search from the beginning next time */
+		free(strm->delim);
+		strm->delim = NULL;
+		strm->dlen = 0;
+		return;
+	}
+
+	memcpy(copy, delim, dlen);
+	strm->delim = copy;
+	strm->dlen = dlen;
+}
+
+/* reads until the read buffer contains a frame, which ends with a delimiter or
+ * consists of exactly max bytes if there's no delimiter; if there's no complete
+ * frame yet, the data is kept for the next call */
+static enum b6b_res b6b_strm_read_frame(struct b6b_interp *interp,
+                                        struct b6b_obj *o,
+                                        const char *delim,
+                                        const size_t dlen,
+                                        const size_t max)
+{
+	struct b6b_strm *strm = (struct b6b_strm *)o->priv;
+	struct b6b_obj *s;
+	const char *p;
+	size_t len, lim;
+	ssize_t out, want;
+	enum b6b_res res = B6B_ERR;
+
+	/* the stream may be freed during context switch */
+	b6b_ref(o);
+
+	if (delim)
+		b6b_strm_set_delim(strm, delim, dlen);
+
+	do {
+		len = strm->rbuf.len;
+
+		if (delim) {
+			/* the frame cannot be longer than max, even if the delimiter
+			 * follows */
+			lim = (max && (len > max)) ? max : len;
+
+			/* don't scan the same data twice, even across calls */
+			if (lim >= strm->scan + dlen) {
+				p = (const char *)memmem(b6b_buf_head(&strm->rbuf) + strm->scan,
+				                         lim - strm->scan,
+				                         delim,
+				                         dlen);
+				if (p) {
+					len = p - b6b_buf_head(&strm->rbuf) + dlen;
+					break;
+				}
+
+				strm->scan = lim - dlen + 1;
+			}
+
+			if (max && (len >= max)) {
+				b6b_return_fmt(interp, "no delimiter in %zu bytes", max);
+				goto out;
+			}
+
+			want = max ? (ssize_t)(max - len) : SSIZE_MAX - 1;
+		} else if (len >= max) {
+			len = max;
+			break;
+		} else
+			want = (ssize_t)(max - len);
+
+		out = b6b_strm_fill(interp, strm, &strm->rbuf, want);
+		if (out < 0)
+			goto out;
+
+		if (out)
+			continue;
+
+		if (!b6b_strm_eof(interp, strm)) {
+			res = B6B_OK;
+			goto out;
+		}
+
+		/* at EOF, the remaining data is the last frame, unless its length is
+		 * wrong */
+		if (!strm->rbuf.len) {
+			b6b_return_fmt(interp, "eof");
+			goto out;
+		}
+
+		if (!delim) {
+			b6b_return_fmt(interp, "eof after %zu bytes", strm->rbuf.len);
+			goto out;
+		}
+
+		len = strm->rbuf.len;
+		break;
 	} while (1);
 
-	buf[out] = '\0';
-	o = b6b_str_new((char *)buf, (size_t)out);
+	s = b6b_buf_take(&strm->rbuf, len);
+	if (b6b_likely(s)) {
+		b6b_strm_consume(strm, len);
+		res = b6b_return(interp, s);
+	}
+
+out:
+	b6b_unref(o);
+	return res;
+}
+
+static enum b6b_res b6b_strm_read(struct b6b_interp *interp,
+                                  struct b6b_strm *strm,
+                                  ssize_t want)
+{
+	struct b6b_buf buf;
+	struct b6b_obj *o;
+	size_t len;
+
+	/* return data read ahead first */
+	if (strm->rbuf.len) {
+		len = ((size_t)want < strm->rbuf.len) ? (size_t)want : strm->rbuf.len;
+		o = b6b_buf_take(&strm->rbuf, len);
+		if (b6b_unlikely(!o))
+			return B6B_ERR;
+
+		b6b_strm_consume(strm, len);
+		return b6b_return(interp, o);
+	}
+
+	if (strm->flags & B6B_STRM_EOF)
+		return B6B_OK;
+
+	b6b_buf_init(&buf);
+
+	if (b6b_strm_fill(interp, strm, &buf, want) < 0) {
+		b6b_buf_free(&buf);
+		return B6B_ERR;
+	}
+
+	o = b6b_buf_take(&buf, buf.len);
 	if (b6b_unlikely(!o)) {
-		free(buf);
+		b6b_buf_free(&buf);
 		return B6B_ERR;
 	}
 
 	return b6b_return(interp, o);
 }
 
+static enum b6b_res b6b_strm_read_into(struct b6b_interp *interp,
+                                       struct b6b_strm *strm,
+                                       struct b6b_obj *o,
+                                       ssize_t want)
+{
+	struct b6b_buf *buf;
+	ssize_t out;
+
+	buf = b6b_buf_get(o);
+	if (!buf)
+		return B6B_ERR;
+
+	if (strm->rbuf.len) {
+		out = ((size_t)want < strm->rbuf.len) ? want : (ssize_t)strm->rbuf.len;
+		if (!b6b_buf_append(buf, b6b_buf_head(&strm->rbuf), (size_t)out))
+			return B6B_ERR;
+
+		b6b_buf_consume(&strm->rbuf, (size_t)out);
+		b6b_strm_consume(strm, (size_t)out);
+		return b6b_return_int(interp, (b6b_int)out);
+	}
+
+	/* the buffer may be freed during context switch */
+	b6b_ref(o);
+	out = b6b_strm_fill(interp, strm, buf, want);
+	b6b_unref(o);
+
+	if (out < 0)
+		return B6B_ERR;
+
+	return b6b_return_int(interp, (b6b_int)out);
+}
+
 static enum b6b_res b6b_strm_write(struct b6b_interp *interp,
                                    struct b6b_strm *strm,
                                    const unsigned char *buf,
@@ -151,8 +386,12 @@ static enum b6b_res b6b_strm_write(struct b6b_interp *interp,
 		if (chunk < 0)
 			return B6B_ERR;
 
-		if (!chunk)
+		if (!chunk) {
+			if (b6b_strm_wait(interp, strm, B6B_IO_OUT))
+				continue;
+
 			break;
+		}
 
 		out += chunk;
 	}
@@ -199,8 +438,12 @@ static enum b6b_res b6b_strm_accept(struct b6b_interp *interp,
 			return B6B_ERR;
 		}
 
-		if (!o)
+		if (!o) {
+			if (b6b_list_empty(l) && b6b_strm_wait(interp, strm, B6B_IO_IN))
+				continue;
+
 			break;
+		}
 
 		if (b6b_unlikely(!b6b_list_add(l, o))) {
 			b6b_destroy(o);
@@ -246,13 +489,19 @@ static enum b6b_res b6b_strm_fd(struct b6b_interp *interp,
 	return b6b_return(interp, fdo);
 }
 
+/* checks the size argument of a read operation */
+static int b6b_strm_size(struct b6b_obj *o)
+{
+	return b6b_as_int(o) && (o->i < SSIZE_MAX) && (o->i > 0);
+}
+
 static enum b6b_res b6b_strm_proc(struct b6b_interp *interp,
                                   struct b6b_obj *args)
 {
-	struct b6b_obj *o, *op, *arg;
+	struct b6b_obj *o, *op, *arg, *max;
 	unsigned int argc;
 
-	argc = b6b_proc_get_args(interp, args, "os|o", &o, &op, &arg);
+	argc = b6b_proc_get_args(interp, args, "os|oo", &o, &op, &arg, &max);
 
 	switch (argc) {
 		case 2:
@@ -260,7 +509,9 @@ static enum b6b_res b6b_strm_proc(struct b6b_interp *interp,
 				return b6b_strm_read(interp,
 				                     (struct b6b_strm *)o->priv,
 				                     SSIZE_MAX - 1);
-			} else if (strcmp(op->s, "accept") == 0)
+			} else if (strcmp(op->s, "readline") == 0)
+				return b6b_strm_read_frame(interp, o, "\n", 1, 0);
+			else if (strcmp(op->s, "accept") == 0)
 				return b6b_strm_accept(interp, (struct b6b_strm *)o->priv);
 			else if (strcmp(op->s, "peer") == 0)
 				return b6b_strm_peer(interp, (struct b6b_strm *)o->priv);
@@ -274,13 +525,37 @@ static enum b6b_res b6b_strm_proc(struct b6b_interp *interp,
 
 		case 3:
 			if (strcmp(op->s, "read") == 0) {
-				if (!b6b_as_int(arg) || (arg->i >= SSIZE_MAX) || (arg->i <= 0))
+				if (!b6b_strm_size(arg))
 					return B6B_ERR;
 
 				return b6b_strm_read(interp,
 				                     (struct b6b_strm *)o->priv,
 				                     (ssize_t)arg->i);
 			}
+			else if (strcmp(op->s, "readline") == 0) {
+				if (!b6b_strm_size(arg))
+					return B6B_ERR;
+
+				return b6b_strm_read_frame(interp, o, "\n", 1, (size_t)arg->i);
+			}
+			else if (strcmp(op->s, "readuntil") == 0) {
+				if (!b6b_as_str(arg) || !arg->slen)
+					return B6B_ERR;
+
+				return b6b_strm_read_frame(interp, o, arg->s, arg->slen, 0);
+			}
+			else if (strcmp(op->s, "readexact") == 0) {
+				if (!b6b_strm_size(arg))
+					return B6B_ERR;
+
+				return b6b_strm_read_frame(interp, o, NULL, 0, (size_t)arg->i);
+			}
+			else if (strcmp(op->s, "read_into") == 0) {
+				return b6b_strm_read_into(interp,
+				                          (struct b6b_strm *)o->priv,
+				                          arg,
+				                          SSIZE_MAX - 1);
+			}
 			else if (strcmp(op->s, "write") == 0) {
 				if (!b6b_as_str(arg))
 					return B6B_ERR;
@@ -300,6 +575,28 @@ static enum b6b_res b6b_strm_proc(struct b6b_interp *interp,
 				                        arg->slen);
 			}
 			break;
+
+		case 4:
+			if (strcmp(op->s, "readuntil") == 0) {
+				if (!b6b_as_str(arg) || !arg->slen || !b6b_strm_size(max))
+					return B6B_ERR;
+
+				return b6b_strm_read_frame(interp,
+				                           o,
+				                           arg->s,
+				                           arg->slen,
+				                           (size_t)max->i);
+			}
+			else if (strcmp(op->s, "read_into") == 0) {
+				if (!b6b_strm_size(max))
+					return B6B_ERR;
+
+				return b6b_strm_read_into(interp,
+				                          (struct b6b_strm *)o->priv,
+				                          arg,
+				                          (ssize_t)max->i);
+			}
+			break;
 	}
 
 	if (argc >= 2)
@@ -324,6 +621,10 @@ static struct b6b_obj *b6b_strm_new(struct b6b_interp *interp,
 
 		strm->ops = ops;
 		strm->priv = priv;
+		b6b_buf_init(&strm->rbuf);
+		strm->delim = NULL;
+		strm->dlen = 0;
+		strm->scan = 0;
 		strm->flags = 0;
 
 		o->priv = strm;
@@ -353,3 +654,21 @@ struct b6b_obj *b6b_strm_fmt(struct b6b_interp *interp,
 	                    priv,
 	                    b6b_str_fmt("%s:%"PRIxPTR, type, (uintptr_t)priv));
 }
+
+int b6b_strm_obj_fd(struct b6b_obj *o)
+{
+	struct b6b_strm *strm = (struct b6b_strm *)o->priv;
+
+	if ((o->proc != b6b_strm_proc) ||
+	    (strm->flags & B6B_STRM_CLOSED) ||
+	    !strm->ops->fd)
+		return -1;
+
+	return strm->ops->fd(strm->priv);
+}
+
+void b6b_strm_obj_close(struct b6b_obj *o)
+{
+	if (o->proc == b6b_strm_proc)
+		b6b_strm_close((struct b6b_strm *)o->priv);
+}
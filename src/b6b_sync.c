@@ -0,0 +1,330 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2026 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <b6b.h>
+
+struct b6b_mutex {
+	struct b6b_lock lock;
+};
+
+struct b6b_cond {
+	struct b6b_waitq waiters;
+};
+
+struct b6b_waitgroup {
+	b6b_int n;
+	struct b6b_waitq waiters;
+};
+
+static struct b6b_obj *b6b_sync_new(const char *type,
+                                    void *priv,
+                                    b6b_procf proc,
+                                    b6b_delf del)
+{
+	struct b6b_obj *o;
+
+	o = b6b_str_fmt("%s:%"PRIxPTR, type, (uintptr_t)priv);
+	if (b6b_unlikely(!o)) {
+		free(priv);
+		return NULL;
+	}
+
+	o->priv = priv;
+	o->proc = proc;
+	o->del = del;
+
+	return o;
+}
+
+static enum b6b_res b6b_mutex_lock(struct b6b_interp *interp,
+                                   struct b6b_mutex *m)
+{
+	while (m->lock.owner) {
+		/* the mutex is not recursive */
+		if (m->lock.owner == interp->fg)
+			return B6B_ERR;
+
+		if (!b6b_wait_on(interp, &m->lock.waiters))
+			return B6B_ERR;
+	}
+
+	b6b_lock_take(&m->lock, interp->fg);
+	return B6B_OK;
+}
+
+static void b6b_mutex_release(struct b6b_interp *interp, struct b6b_mutex *m)
+{
+	b6b_lock_drop(&m->lock);
+	b6b_notify(interp, &m->lock.waiters);
+}
+
+static enum b6b_res b6b_mutex_unlock(struct b6b_interp *interp,
+                                     struct b6b_mutex *m)
+{
+	if (m->lock.owner != interp->fg)
+		return B6B_ERR;
+
+	b6b_mutex_release(interp, m);
+	return B6B_OK;
+}
+
+static void b6b_mutex_del(void *priv)
+{
+	struct b6b_mutex *m = (struct b6b_mutex *)priv;
+
+	/* the owner may still be running */
+	if (m->lock.owner)
+		b6b_lock_drop(&m->lock);
+
+	free(m);
+}
+
+static enum b6b_res b6b_mutex_proc(struct b6b_interp *interp,
+                                   struct b6b_obj *args)
+{
+	struct b6b_obj *o, *op;
+	struct b6b_mutex *m;
+
+	if (b6b_proc_get_args(interp, args, "os", &o, &op)) {
+		m = (struct b6b_mutex *)o->priv;
+
+		if (strcmp(op->s, "lock") == 0)
+			return b6b_mutex_lock(interp, m);
+		else if (strcmp(op->s, "unlock") == 0)
+			return b6b_mutex_unlock(interp, m);
+		else if (strcmp(op->s, "trylock") == 0) {
+			if (m->lock.owner)
+				return b6b_return_false(interp);
+
+			b6b_lock_take(&m->lock, interp->fg);
+			return b6b_return_true(interp);
+		}
+
+		b6b_return_fmt(interp, "bad mutex op: %s", op->s);
+	}
+
+	return B6B_ERR;
+}
+
+static enum b6b_res b6b_sync_proc_mutex(struct b6b_interp *interp,
+                                        struct b6b_obj *args)
+{
+	struct b6b_obj *o;
+	struct b6b_mutex *m;
+
+	if (!b6b_proc_get_args(interp, args, "o", NULL))
+		return B6B_ERR;
+
+	m = (struct b6b_mutex *)malloc(sizeof(*m));
+	if (!b6b_allocated(m))
+		return B6B_ERR;
+
+	b6b_lock_init(&m->lock);
+
+	o = b6b_sync_new("mutex", m, b6b_mutex_proc, b6b_mutex_del);
+	if (b6b_unlikely(!o))
+		return B6B_ERR;
+
+	return b6b_return(interp, o);
+}
+
+static enum b6b_res b6b_cond_wait(struct b6b_interp *interp,
+                                  struct b6b_cond *c,
+                                  struct b6b_obj *mo)
+{
+	struct b6b_mutex *m;
+
+	if (mo->proc != b6b_mutex_proc)
+		return B6B_ERR;
+
+	m = (struct b6b_mutex *)mo->priv;
+	if (m->lock.owner != interp->fg)
+		return B6B_ERR;
+
+	/* release the mutex while waiting, then reacquire it */
+	b6b_mutex_release(interp, m);
+
+	if (!b6b_wait_on(interp, &c->waiters))
+		return B6B_ERR;
+
+	return b6b_mutex_lock(interp, m);
+}
+
+static enum b6b_res b6b_cond_proc(struct b6b_interp *interp,
+                                  struct b6b_obj *args)
+{
+	struct b6b_obj *o, *op, *m;
+	struct b6b_cond *c;
+	unsigned int argc;
+
+	argc = b6b_proc_get_args(interp, args, "os|o", &o, &op, &m);
+	if (!argc)
+		return B6B_ERR;
+
+	c = (struct b6b_cond *)o->priv;
+
+	switch (argc) {
+		case 2:
+			if (strcmp(op->s, "signal") == 0) {
+				b6b_notify(interp, &c->waiters);
+				return B6B_OK;
+			} else if (strcmp(op->s, "broadcast") == 0) {
+				b6b_notify_all(interp, &c->waiters);
+				return B6B_OK;
+			}
+			break;
+
+		case 3:
+			if (strcmp(op->s, "wait") == 0)
+				return b6b_cond_wait(interp, c, m);
+			break;
+	}
+
+	if (argc >= 2)
+		b6b_return_fmt(interp, "bad cond op: %s", op->s);
+
+	return B6B_ERR;
+}
+
+static enum b6b_res b6b_sync_proc_cond(struct b6b_interp *interp,
+                                       struct b6b_obj *args)
+{
+	struct b6b_obj *o;
+	struct b6b_cond *c;
+
+	if (!b6b_proc_get_args(interp, args, "o", NULL))
+		return B6B_ERR;
+
+	c = (struct b6b_cond *)malloc(sizeof(*c));
+	if (!b6b_allocated(c))
+		return B6B_ERR;
+
+	b6b_waitq_init(&c->waiters);
+
+	o = b6b_sync_new("cond", c, b6b_cond_proc, free);
+	if (b6b_unlikely(!o))
+		return B6B_ERR;
+
+	return b6b_return(interp, o);
+}
+
+static enum b6b_res b6b_waitgroup_add(struct b6b_interp *interp,
+                                      struct b6b_waitgroup *wg,
+                                      const b6b_int n)
+{
+	/* the counter is never negative, so only adding can overflow */
+	if (((n > 0) && (wg->n > B6B_INT_MAX - n)) || ((wg->n + n) < 0))
+		return B6B_ERR;
+
+	wg->n += n;
+	if (!wg->n)
+		b6b_notify_all(interp, &wg->waiters);
+
+	return B6B_OK;
+}
+
+static enum b6b_res b6b_waitgroup_proc(struct b6b_interp *interp,
+                                       struct b6b_obj *args)
+{
+	struct b6b_obj *o, *op, *n;
+	struct b6b_waitgroup *wg;
+	unsigned int argc;
+
+	argc = b6b_proc_get_args(interp, args, "os|i", &o, &op, &n);
+	if (!argc)
+		return B6B_ERR;
+
+	wg = (struct b6b_waitgroup *)o->priv;
+
+	switch (argc) {
+		case 2:
+			if (strcmp(op->s, "wait") == 0) {
+				while (wg->n) {
+					if (!b6b_wait_on(interp, &wg->waiters))
+						return B6B_ERR;
+				}
+
+				return B6B_OK;
+			} else if (strcmp(op->s, "done") == 0)
+				return b6b_waitgroup_add(interp, wg, -1);
+			else if (strcmp(op->s, "add") == 0)
+				return b6b_waitgroup_add(interp, wg, 1);
+			else if (strcmp(op->s, "len") == 0)
+				return b6b_return_int(interp, wg->n);
+			break;
+
+		case 3:
+			if (strcmp(op->s, "add") == 0)
+				return b6b_waitgroup_add(interp, wg, n->i);
+			break;
+	}
+
+	if (argc >= 2)
+		b6b_return_fmt(interp, "bad waitgroup op: %s", op->s);
+
+	return B6B_ERR;
+}
+
+static enum b6b_res b6b_sync_proc_waitgroup(struct b6b_interp *interp,
+                                            struct b6b_obj *args)
+{
+	struct b6b_obj *o;
+	struct b6b_waitgroup *wg;
+
+	if (!b6b_proc_get_args(interp, args, "o", NULL))
+		return B6B_ERR;
+
+	wg = (struct b6b_waitgroup *)malloc(sizeof(*wg));
+	if (!b6b_allocated(wg))
+		return B6B_ERR;
+
+	wg->n = 0;
+	b6b_waitq_init(&wg->waiters);
+
+	o = b6b_sync_new("waitgroup", wg, b6b_waitgroup_proc, free);
+	if (b6b_unlikely(!o))
+		return B6B_ERR;
+
+	return b6b_return(interp, o);
+}
+
+static const struct b6b_ext_obj b6b_sync[] = {
+	{
+		.name = "mutex",
+		.type = B6B_TYPE_STR,
+		.val.s = "mutex",
+		.proc = b6b_sync_proc_mutex
+	},
+	{
+		.name = "cond",
+		.type = B6B_TYPE_STR,
+		.val.s = "cond",
+		.proc = b6b_sync_proc_cond
+	},
+	{
+		.name = "waitgroup",
+		.type = B6B_TYPE_STR,
+		.val.s = "waitgroup",
+		.proc = b6b_sync_proc_waitgroup
+	}
+};
+__b6b_ext(b6b_sync);
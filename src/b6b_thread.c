@@ -19,17 +19,152 @@
 #include <stdlib.h>
 #ifdef B6B_HAVE_THREADS
 #	include <string.h>
+#	include <stdint.h>
 #	include <limits.h>
 #	include <signal.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
 #	ifdef B6B_HAVE_VALGRIND
 #		include <valgrind/valgrind.h>
 #	endif
+#	ifdef __SANITIZE_ADDRESS__
+#		include <sanitizer/asan_interface.h>
+#	endif
 #endif
 
 #include <b6b.h>
 
+#ifdef B6B_HAVE_THREADS
+
+int b6b_stacks_init(struct b6b_stacks *stks, const size_t pages)
+{
+	long pgsiz;
+
+	stks->free = NULL;
+	stks->nfree = 0;
+
+	pgsiz = sysconf(_SC_PAGESIZE);
+	if (pgsiz <= 0)
+		return 0;
+
+	stks->pgsiz = (size_t)pgsiz;
+	stks->size = stks->pgsiz * pages;
+	return 1;
+}
+
+static void b6b_stack_unmap(struct b6b_stacks *stks,
+                            void *p,
+                            const size_t len)
+{
+#	ifdef __SANITIZE_ADDRESS__
+	/* AddressSanitizer poisons parts of the stack while a thread runs and
+	 * doesn't forget that when the stack is unmapped, so memory mapped later
+	 * at the same address would look poisoned */
+	ASAN_UNPOISON_MEMORY_REGION((char *)p + stks->pgsiz, len - stks->pgsiz);
+#	endif
+	munmap(p, len);
+}
+
+static void *b6b_stack_new(struct b6b_stacks *stks, size_t *size)
+{
+	struct b6b_stack *s;
+	char *p;
+
+	/* a smaller stack is too small for B6B_MAX_NESTING nested calls and would
+	 * hit the guard page, so the default size is also the minimum */
+	if (*size <= stks->size)
+		*size = stks->size;
+	else if (*size > SIZE_MAX - 2 * stks->pgsiz)
+		return NULL;
+	else
+		*size = (*size + stks->pgsiz - 1) & ~(stks->pgsiz - 1);
+
+	if (stks->free && (stks->free->size == *size)) {
+		s = stks->free;
+		stks->free = s->next;
+		--stks->nfree;
+		return (char *)s + sizeof(*s) - *size;
+	}
+
+	/* we reserve address space for the stack, but pages are allocated only
+	 * when touched, so a big stack costs nothing until a thread uses it */
+	p = mmap(NULL,
+	         *size + stks->pgsiz,
+	         PROT_READ | PROT_WRITE,
+	         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK,
+	         -1,
+	         0);
+	if (p == MAP_FAILED)
+		return NULL;
+
+	/* the stack is preceded by a guard page, so a stack overflow crashes the
+	 * process instead of silently corrupting memory */
+	if (mprotect(p, stks->pgsiz, PROT_NONE) < 0) {
+		munmap(p, *size + stks->pgsiz);
+		return NULL;
+	}
+
+	return p + stks->pgsiz;
+}
+
+static void b6b_stack_free(struct b6b_stacks *stks,
+                           void *stack,
+                           const size_t size)
+{
+	struct b6b_stack *s;
+
+	if ((size == stks->size) && (stks->nfree < B6B_STACKS_MAX)) {
+		s = (struct b6b_stack *)((char *)stack + size - sizeof(*s));
+		s->size = size;
+		s->next = stks->free;
+		stks->free = s;
+		++stks->nfree;
+		return;
+	}
+
+	b6b_stack_unmap(stks, (char *)stack - stks->pgsiz, size + stks->pgsiz);
+}
+
+void b6b_stacks_destroy(struct b6b_stacks *stks)
+{
+	struct b6b_stack *s;
+
+	while (stks->free) {
+		s = stks->free;
+		stks->free = s->next;
+		b6b_stack_unmap(stks,
+		                (char *)s + sizeof(*s) - s->size - stks->pgsiz,
+		                s->size + stks->pgsiz);
+	}
+
+	stks->nfree = 0;
+}
+
+int b6b_stacks_set_size(struct b6b_stacks *stks, const size_t size)
+{
+	if ((size < stks->pgsiz * B6B_STACK_PAGES) ||
+	    (size > SIZE_MAX - 2 * stks->pgsiz))
+		return 0;
+
+	/* unused stacks of the previous size would never be reused */
+	b6b_stacks_destroy(stks);
+
+	stks->size = (size + stks->pgsiz - 1) & ~(stks->pgsiz - 1);
+	return 1;
+}
+
+#endif
+
 void b6b_thread_destroy(struct b6b_thread *t)
 {
+#ifdef B6B_HAVE_THREADS
+	struct b6b_lock *l;
+
+	/* locks may outlive the thread that holds them */
+	while ((l = b6b_lock_held(t)))
+		b6b_lock_drop(l);
+
+#endif
 	if (t->_)
 		b6b_unref(t->_);
 
@@ -46,7 +181,7 @@ void b6b_thread_destroy(struct b6b_thread *t)
 #	ifdef B6B_HAVE_VALGRIND
 		VALGRIND_STACK_DEREGISTER(t->sid);
 #	endif
-		free(t->stack);
+		b6b_stack_free(t->stks, t->stack, t->stksiz);
 	}
 #endif
 
@@ -61,63 +196,228 @@ void b6b_thread_pop(struct b6b_threads *ts, struct b6b_thread *t)
 	b6b_thread_destroy(t);
 }
 
+static void b6b_thread_start(struct b6b_thread *t)
+{
+	t->entry(t, t->arg);
+}
+
+#	ifdef B6B_HAVE_CTX_SWAP
+
+/* b6b_ctx_swap() saves the callee-saved registers on the current stack, stores
+ * the stack pointer in *from and restores the registers saved on the stack
+ * pointed by to; b6b_ctx_start() is the return address of a new thread: it
+ * calls b6b_thread_start(), which never returns */
+void b6b_ctx_swap(void **from, void *to);
+void b6b_ctx_start(void);
+
+#		if defined(__x86_64__)
+
+__asm__(
+	".text\n"
+	".globl b6b_ctx_swap\n"
+	".hidden b6b_ctx_swap\n"
+	".type b6b_ctx_swap, @function\n"
+	"b6b_ctx_swap:\n"
+	"	pushq %rbp\n"
+	"	pushq %rbx\n"
+	"	pushq %r12\n"
+	"	pushq %r13\n"
+	"	pushq %r14\n"
+	"	pushq %r15\n"
+	"	subq $8, %rsp\n"
+	"	stmxcsr (%rsp)\n"
+	"	fnstcw 4(%rsp)\n"
+	"	movq %rsp, (%rdi)\n"
+	"	movq %rsi, %rsp\n"
+	"	ldmxcsr (%rsp)\n"
+	"	fldcw 4(%rsp)\n"
+	"	addq $8, %rsp\n"
+	"	popq %r15\n"
+	"	popq %r14\n"
+	"	popq %r13\n"
+	"	popq %r12\n"
+	"	popq %rbx\n"
+	"	popq %rbp\n"
+	"	ret\n"
+	".size b6b_ctx_swap, .-b6b_ctx_swap\n"
+	".globl b6b_ctx_start\n"
+	".hidden b6b_ctx_start\n"
+	".type b6b_ctx_start, @function\n"
+	"b6b_ctx_start:\n"
+	"	movq %r12, %rdi\n"
+	"	callq *%rbx\n"
+	"	ud2\n"
+	".size b6b_ctx_start, .-b6b_ctx_start\n"
+);
+
+static void b6b_thread_ctx_init(struct b6b_thread *t, const size_t stksiz)
+{
+	uintptr_t *sp;
+
+	/* b6b_ctx_start() must be entered with a 16 byte aligned stack pointer,
+	 * so the call to b6b_thread_start() leaves it aligned as the ABI
+	 * requires */
+	sp = (uintptr_t *)(((uintptr_t)t->stack + stksiz) & ~(uintptr_t)15) - 2;
+
+	*--sp = (uintptr_t)b6b_ctx_start;
+	*--sp = 0; /* %rbp */
+	*--sp = (uintptr_t)b6b_thread_start; /* %rbx */
+	*--sp = (uintptr_t)t; /* %r12 */
+	*--sp = 0; /* %r13 */
+	*--sp = 0; /* %r14 */
+	*--sp = 0; /* %r15 */
+	/* the default x87 control word and MXCSR */
+	*--sp = ((uintptr_t)0x037F << 32) | 0x1F80;
+
+	t->sp = sp;
+}
+
+#		elif defined(__aarch64__)
+
+__asm__(
+	".text\n"
+	".globl b6b_ctx_swap\n"
+	".hidden b6b_ctx_swap\n"
+	".type b6b_ctx_swap, %function\n"
+	"b6b_ctx_swap:\n"
+	"	sub sp, sp, #160\n"
+	"	stp x19, x20, [sp, #0]\n"
+	"	stp x21, x22, [sp, #16]\n"
+	"	stp x23, x24, [sp, #32]\n"
+	"	stp x25, x26, [sp, #48]\n"
+	"	stp x27, x28, [sp, #64]\n"
+	"	stp x29, x30, [sp, #80]\n"
+	"	stp d8, d9, [sp, #96]\n"
+	"	stp d10, d11, [sp, #112]\n"
+	"	stp d12, d13, [sp, #128]\n"
+	"	stp d14, d15, [sp, #144]\n"
+	"	mov x2, sp\n"
+	"	str x2, [x0]\n"
+	"	mov sp, x1\n"
+	"	ldp x19, x20, [sp, #0]\n"
+	"	ldp x21, x22, [sp, #16]\n"
+	"	ldp x23, x24, [sp, #32]\n"
+	"	ldp x25, x26, [sp, #48]\n"
+	"	ldp x27, x28, [sp, #64]\n"
+	"	ldp x29, x30, [sp, #80]\n"
+	"	ldp d8, d9, [sp, #96]\n"
+	"	ldp d10, d11, [sp, #112]\n"
+	"	ldp d12, d13, [sp, #128]\n"
+	"	ldp d14, d15, [sp, #144]\n"
+	"	add sp, sp, #160\n"
+	"	ret\n"
+	".size b6b_ctx_swap, .-b6b_ctx_swap\n"
+	".globl b6b_ctx_start\n"
+	".hidden b6b_ctx_start\n"
+	".type b6b_ctx_start, %function\n"
+	"b6b_ctx_start:\n"
+	"	mov x0, x20\n"
+	"	blr x19\n"
+	"	brk #0\n"
+	".size b6b_ctx_start, .-b6b_ctx_start\n"
+);
+
+static void b6b_thread_ctx_init(struct b6b_thread *t, const size_t stksiz)
+{
+	uintptr_t *sp;
+
+	sp = (uintptr_t *)(((uintptr_t)t->stack + stksiz) & ~(uintptr_t)15) - 20;
+	memset(sp, 0, sizeof(uintptr_t) * 20);
+
+	sp[0] = (uintptr_t)b6b_thread_start; /* x19 */
+	sp[1] = (uintptr_t)t; /* x20 */
+	sp[11] = (uintptr_t)b6b_ctx_start; /* x30 */
+
+	t->sp = sp;
+}
+
+#		endif
+
+#	else
+
+static void b6b_thread_uc_start(const int th, const int tl)
+{
+	struct b6b_thread *t = (struct b6b_thread *)(uintptr_t)tl;
+
+	if (sizeof(int) < sizeof(uintptr_t)) {
+#		define INTBITS (sizeof(int) * 8)
+		t = (struct b6b_thread *)(uintptr_t)((uint64_t)th << INTBITS | (unsigned int)tl);
+	}
+
+	b6b_thread_start(t);
+}
+
+#	endif
+
 static int b6b_thread_prep(struct b6b_thread *t,
                            struct b6b_obj *fn,
                            struct b6b_frame *global,
                            struct b6b_obj *null,
-                           void (*routine)(int, int, int, int),
-                           void *priv,
+                           b6b_thread_entry entry,
+                           void *arg,
+                           struct b6b_stacks *stks,
                            const size_t stksiz)
 {
 	memset(t, 0, sizeof(*t));
+	b6b_locks_init(&t->locks);
 
+#	ifndef B6B_HAVE_CTX_SWAP
 	if (getcontext(&t->ucp) < 0)
 		return 0;
+#	endif
 
 	t->curr = b6b_frame_new(global);
 	if (b6b_unlikely(!t->curr))
 		return 0;
 
+#	ifndef B6B_HAVE_CTX_SWAP
 	/* this isn't the main thread: block all signals; otherwise, terminating
-	 * signals may kill the process, bypassing signal handling */
+	 * signals may kill the process, bypassing signal handling; when we switch
+	 * threads without ucontext, all threads share the signal mask of the
+	 * main thread, so we don't pay for a system call in every switch */
 	if (sigfillset(&t->ucp.uc_sigmask) < 0)
 		goto bail;
+#	endif
 
-	if (!t->stack) {
-		t->stack = malloc(stksiz);
-		if (!b6b_allocated(t->stack))
-			goto bail;
+	t->stksiz = stksiz;
+	t->stack = b6b_stack_new(stks, &t->stksiz);
+	if (!t->stack)
+		goto bail;
 
-#ifdef B6B_HAVE_VALGRIND
-		t->sid = VALGRIND_STACK_REGISTER(t->stack, t->stack + stksiz);
-#endif
-	}
+	t->stks = stks;
+#	ifdef B6B_HAVE_VALGRIND
+	t->sid = VALGRIND_STACK_REGISTER(t->stack, (char *)t->stack + t->stksiz);
+#	endif
+
+	t->entry = entry;
+	t->arg = arg;
+	t->prio = 0;
 
-	t->ucp.uc_stack.ss_size = stksiz;
+#	ifdef B6B_HAVE_CTX_SWAP
+	b6b_thread_ctx_init(t, t->stksiz);
+#	else
+	t->ucp.uc_stack.ss_size = t->stksiz;
 	/* it's OK to assign NULL in uc_link, since we always b6b_yield() after
 	 * the thread routine: the thread routine does not return */
 	t->ucp.uc_link = NULL;
 	t->ucp.uc_stack.ss_sp = t->stack;
 
-	t->fn = b6b_ref(fn);
-	t->flags = B6B_THREAD_BG;
-
 	if (sizeof(int) < sizeof(uintptr_t))
 		makecontext(&t->ucp,
-		            (void (*)(void))routine,
-		            4,
+		            (void (*)(void))b6b_thread_uc_start,
+		            2,
 		            (int)((uint64_t)(uintptr_t)t >> 32),
-		            (int)((uint64_t)(uintptr_t)t & UINT_MAX),
-		            (int)((uint64_t)(uintptr_t)priv >> 32),
-		            (int)((uint64_t)(uintptr_t)priv & UINT_MAX));
+		            (int)((uint64_t)(uintptr_t)t & UINT_MAX));
 	else
 		makecontext(&t->ucp,
-		            (void (*)(void))routine,
-		            4,
-		            0,
-		            (int)(uintptr_t)t,
+		            (void (*)(void))b6b_thread_uc_start,
+		            2,
 		            0,
-		            (int)(uintptr_t)priv);
+		            (int)(uintptr_t)t);
+#	endif
+
+	t->fn = b6b_ref(fn);
+	t->flags = B6B_THREAD_BG;
 
 	t->_ = b6b_ref(null);
 	t->depth = 1;
@@ -132,8 +432,9 @@ struct b6b_thread *b6b_thread_new(struct b6b_threads *threads,
                                   struct b6b_obj *fn,
                                   struct b6b_frame *global,
                                   struct b6b_obj *null,
-                                  void (*routine)(int, int, int, int),
-                                  void *priv,
+                                  b6b_thread_entry entry,
+                                  void *arg,
+                                  struct b6b_stacks *stks,
                                   const size_t stksiz)
 {
 	struct b6b_thread *t;
@@ -146,8 +447,9 @@ struct b6b_thread *b6b_thread_new(struct b6b_threads *threads,
 	                     fn,
 	                     global,
 	                     null,
-	                     routine,
-	                     priv,
+	                     entry,
+	                     arg,
+	                     stks,
 	                     stksiz))
 		return NULL;
 
@@ -162,7 +464,11 @@ void b6b_thread_swap(struct b6b_thread *bg, struct b6b_thread *fg)
 	bg->flags &= ~B6B_THREAD_FG;
 	bg->flags |= B6B_THREAD_BG;
 
+#	ifdef B6B_HAVE_CTX_SWAP
+	b6b_ctx_swap(&bg->sp, fg->sp);
+#	else
 	swapcontext(&bg->ucp, &fg->ucp);
+#	endif
 }
 
 #endif
@@ -185,6 +491,8 @@ struct b6b_thread *b6b_thread_self(struct b6b_frame *global,
 #ifdef B6B_HAVE_THREADS
 	t->stack = NULL;
 	t->fn = NULL;
+	t->prio = 0;
+	b6b_locks_init(&t->locks);
 	t->flags = B6B_THREAD_FG;
 #endif
 	t->_ = b6b_ref(null);
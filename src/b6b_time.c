@@ -47,6 +47,15 @@ static enum b6b_res b6b_time_proc_sleep(struct b6b_interp *interp,
 	if (!f->f)
 		return B6B_OK;
 
+	/* if other threads may run meanwhile, the thread sleeps in the scheduler
+	 * instead of occupying an offload thread */
+	if (b6b_threaded(interp)) {
+		if (!b6b_sleep(interp, (uint64_t)(f->f * 1000000000)))
+			return B6B_ERR;
+
+		return B6B_OK;
+	}
+
 	req.tv_sec = (time_t)floor(f->f);
 	req.tv_nsec = labs((long)(1000000000 * (f->f - (b6b_float)req.tv_sec)));
 
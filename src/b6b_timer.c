@@ -31,36 +31,48 @@ static const struct b6b_strm_ops b6b_timer_ops = {
 	.close = b6b_fd_close
 };
 
-static enum b6b_res b6b_timer_proc_timer(struct b6b_interp *interp,
-                                         struct b6b_obj *args)
+struct b6b_obj *b6b_timer_new(struct b6b_interp *interp, const b6b_float f)
 {
 	struct itimerspec its;
-	struct b6b_obj *f, *o;
+	struct b6b_obj *o;
 	int fd, err;
 
-	if (!b6b_proc_get_args(interp, args, "of", NULL, &f) || !f->f)
-		return B6B_ERR;
-
 	fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
-	if (fd < 0)
-		return b6b_return_strerror(interp, errno);
+	if (fd < 0) {
+		b6b_return_strerror(interp, errno);
+		return NULL;
+	}
 
-	its.it_value.tv_sec = (time_t)floor(f->f);
+	its.it_value.tv_sec = (time_t)floor(f);
 	its.it_value.tv_nsec = labs(
-	              (long)(1000000000 * (f->f - (b6b_float)its.it_value.tv_sec)));
+	                  (long)(1000000000 * (f - (b6b_float)its.it_value.tv_sec)));
 	its.it_interval.tv_sec = its.it_value.tv_sec;
 	its.it_interval.tv_nsec = its.it_value.tv_nsec;
 	if (timerfd_settime(fd, 0, &its, NULL) < 0) {
 		err = errno;
 		close(fd);
-		return b6b_return_strerror(interp, err);
+		b6b_return_strerror(interp, err);
+		return NULL;
 	}
 
 	o = b6b_strm_fmt(interp, &b6b_timer_ops, (void *)(intptr_t)fd, "timer");
-	if (b6b_unlikely(!o)) {
+	if (b6b_unlikely(!o))
 		close(fd);
+
+	return o;
+}
+
+static enum b6b_res b6b_timer_proc_timer(struct b6b_interp *interp,
+                                         struct b6b_obj *args)
+{
+	struct b6b_obj *f, *o;
+
+	if (!b6b_proc_get_args(interp, args, "of", NULL, &f) || !f->f)
+		return B6B_ERR;
+
+	o = b6b_timer_new(interp, f->f);
+	if (!o)
 		return B6B_ERR;
-	}
 
 	return b6b_return(interp, o);
 }
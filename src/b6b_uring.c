@@ -0,0 +1,347 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2026 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <b6b.h>
+
+#define B6B_URING_PROBE_OPS 64
+
+struct b6b_uring_op {
+	struct b6b_thread *t;
+	int res;
+	int done;
+};
+
+static int b6b_uring_probe(struct b6b_uring *r)
+{
+	struct io_uring_probe *probe;
+	unsigned int i;
+
+	probe = (struct io_uring_probe *)calloc(1,
+	                                        sizeof(*probe) +
+	                                        B6B_URING_PROBE_OPS *
+	                                        sizeof(probe->ops[0]));
+	if (!b6b_allocated(probe))
+		return 0;
+
+	if (syscall(__NR_io_uring_register,
+	            r->fd,
+	            IORING_REGISTER_PROBE,
+	            probe,
+	            B6B_URING_PROBE_OPS) < 0) {
+		free(probe);
+		return 0;
+	}
+
+	r->ops = 0;
+	for (i = 0; (i < probe->ops_len) && (i < B6B_URING_PROBE_OPS); ++i) {
+		if (probe->ops[i].flags & IO_URING_OP_SUPPORTED)
+			r->ops |= (uint64_t)1 << probe->ops[i].op;
+	}
+
+	free(probe);
+	return 1;
+}
+
+static int b6b_uring_setup(struct b6b_uring *r)
+{
+	struct io_uring_params p;
+	const char *s;
+	size_t cqlen;
+
+	s = getenv(B6B_URING_DISABLE_ENV);
+	if (s && *s)
+		return 0;
+
+	memset(&p, 0, sizeof(p));
+	r->fd = (int)syscall(__NR_io_uring_setup, B6B_URING_ENTRIES, &p);
+	if (r->fd < 0)
+		return 0;
+
+	/* completions are reaped lazily, so the kernel must not drop them; both
+	 * features are supported since Linux 5.5 */
+	if (!(p.features & IORING_FEAT_NODROP) ||
+	    !(p.features & IORING_FEAT_SINGLE_MMAP) ||
+	    !b6b_uring_probe(r))
+		goto close_fd;
+
+	r->rlen = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	cqlen = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (cqlen > r->rlen)
+		r->rlen = cqlen;
+
+	r->rings = mmap(NULL,
+	                r->rlen,
+	                PROT_READ | PROT_WRITE,
+	                MAP_SHARED | MAP_POPULATE,
+	                r->fd,
+	                IORING_OFF_SQ_RING);
+	if (r->rings == MAP_FAILED)
+		goto close_fd;
+
+	r->slen = p.sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes = (struct io_uring_sqe *)mmap(NULL,
+	                                      r->slen,
+	                                      PROT_READ | PROT_WRITE,
+	                                      MAP_SHARED | MAP_POPULATE,
+	                                      r->fd,
+	                                      IORING_OFF_SQES);
+	if (r->sqes == MAP_FAILED)
+		goto unmap_rings;
+
+	r->sq_tail = (unsigned int *)((char *)r->rings + p.sq_off.tail);
+	r->sq_mask = (unsigned int *)((char *)r->rings + p.sq_off.ring_mask);
+	r->sq_array = (unsigned int *)((char *)r->rings + p.sq_off.array);
+	r->cq_head = (unsigned int *)((char *)r->rings + p.cq_off.head);
+	r->cq_tail = (unsigned int *)((char *)r->rings + p.cq_off.tail);
+	r->cq_mask = (unsigned int *)((char *)r->rings + p.cq_off.ring_mask);
+	r->cqes = (struct io_uring_cqe *)((char *)r->rings + p.cq_off.cqes);
+	r->tail = *r->sq_tail;
+
+	return 1;
+
+unmap_rings:
+	munmap(r->rings, r->rlen);
+
+close_fd:
+	close(r->fd);
+	r->fd = -1;
+	return 0;
+}
+
+static int b6b_uring_open(struct b6b_uring *r)
+{
+	if (r->fd >= 0)
+		return 1;
+
+	/* if io_uring is unavailable (e.g. an old kernel or a seccomp filter), we
+	 * don't try again */
+	if (!r->ok)
+		return 0;
+
+	if (!b6b_uring_setup(r)) {
+		r->ok = 0;
+		return 0;
+	}
+
+	return 1;
+}
+
+void b6b_uring_destroy(struct b6b_uring *r)
+{
+	if (r->fd < 0)
+		return;
+
+	munmap(r->sqes, r->slen);
+	munmap(r->rings, r->rlen);
+	close(r->fd);
+}
+
+#define b6b_uring_supported(r, op) ((r)->ops & ((uint64_t)1 << (op)))
+
+static void b6b_uring_push(struct b6b_uring *r,
+                           const struct io_uring_sqe *sqe)
+{
+	const unsigned int i = r->tail & *r->sq_mask;
+
+	r->sqes[i] = *sqe;
+	r->sq_array[i] = i;
+	++r->tail;
+	++r->npending;
+}
+
+/* queues an operation, with an optional timeout, and parks the calling thread
+ * until it's done */
+static int b6b_uring_call(struct b6b_interp *interp,
+                          struct io_uring_sqe *sqe,
+                          const struct __kernel_timespec *timeout,
+                          int *res)
+{
+	struct io_uring_sqe lt;
+	struct b6b_uring_op op = {.t = interp->fg, .done = 0};
+	struct b6b_uring *r = &interp->uring;
+
+	/* each operation uses up to two entries, so the submission queue cannot
+	 * overflow */
+	if (!b6b_threaded(interp) ||
+	    (r->nops >= B6B_URING_ENTRIES / 2) ||
+	    !b6b_uring_open(r) ||
+	    !b6b_uring_supported(r, sqe->opcode) ||
+	    (timeout && !b6b_uring_supported(r, IORING_OP_LINK_TIMEOUT)))
+		return 0;
+
+	sqe->user_data = (uintptr_t)&op;
+
+	if (timeout) {
+		sqe->flags |= IOSQE_IO_LINK;
+		b6b_uring_push(r, sqe);
+
+		/* the completion of the timeout is ignored */
+		memset(&lt, 0, sizeof(lt));
+		lt.opcode = IORING_OP_LINK_TIMEOUT;
+		lt.addr = (uintptr_t)timeout;
+		lt.len = 1;
+		b6b_uring_push(r, &lt);
+	} else
+		b6b_uring_push(r, sqe);
+
+	__atomic_store_n(r->sq_tail, r->tail, __ATOMIC_RELEASE);
+	++r->nops;
+
+	/* the operation is submitted once no thread can run or at the end of the
+	 * current time slice, together with operations queued by other threads;
+	 * the kernel may access buffers on this thread's stack, so we cannot
+	 * return before the operation is done */
+	do {
+		b6b_park(interp);
+	} while (!op.done);
+
+	*res = op.res;
+	return 1;
+}
+
+void b6b_uring_submit(struct b6b_uring *r)
+{
+	int n;
+
+	if (!r->npending)
+		return;
+
+	n = (int)syscall(__NR_io_uring_enter, r->fd, r->npending, 0, 0, NULL, 0);
+	if (n > 0)
+		r->npending -= (unsigned int)n;
+}
+
+void b6b_uring_reap(struct b6b_interp *interp)
+{
+	struct b6b_uring *r = &interp->uring;
+	struct io_uring_cqe *cqe;
+	struct b6b_uring_op *op;
+	unsigned int head, tail;
+
+	if (r->fd < 0)
+		return;
+
+	head = *r->cq_head;
+	tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+	if (head == tail)
+		return;
+
+	do {
+		cqe = &r->cqes[head & *r->cq_mask];
+		op = (struct b6b_uring_op *)(uintptr_t)cqe->user_data;
+		if (op) {
+			op->res = cqe->res;
+			op->done = 1;
+			--r->nops;
+			b6b_wake(interp, op->t);
+		}
+	} while (++head != tail);
+
+	__atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static void b6b_uring_timeout(struct __kernel_timespec *ts,
+                              const uint64_t timeout)
+{
+	ts->tv_sec = (long long)(timeout / 1000000000);
+	ts->tv_nsec = (long long)(timeout % 1000000000);
+}
+
+int b6b_uring_openat(struct b6b_interp *interp,
+                     const char *path,
+                     const int flags,
+                     const mode_t mode,
+                     const uint64_t timeout,
+                     int *res)
+{
+	struct io_uring_sqe sqe;
+	struct __kernel_timespec ts;
+	struct statx stx;
+	uint64_t start, elapsed;
+
+	/* the kernel opens a FIFO without waiting for the other end, unlike
+	 * open(), and opening a device may have side effects, so we look at the
+	 * file first and let the caller open anything special through open() */
+	memset(&sqe, 0, sizeof(sqe));
+	sqe.opcode = IORING_OP_STATX;
+	sqe.fd = AT_FDCWD;
+	sqe.addr = (uintptr_t)path;
+	sqe.len = STATX_TYPE;
+	sqe.off = (uintptr_t)&stx;
+	sqe.statx_flags = AT_STATX_SYNC_AS_STAT;
+
+	/* both operations may block forever, e.g. on a network file system, so
+	 * they share one deadline */
+	start = b6b_now();
+	b6b_uring_timeout(&ts, timeout);
+	if (!b6b_uring_call(interp, &sqe, &ts, res))
+		return 0;
+
+	if (*res == 0) {
+		if (!S_ISREG(stx.stx_mode) && !S_ISDIR(stx.stx_mode))
+			return 0;
+	} else if (*res != -ENOENT)
+		return 1;
+
+	elapsed = b6b_now() - start;
+	if (elapsed >= timeout) {
+		*res = -ECANCELED;
+		return 1;
+	}
+
+	memset(&sqe, 0, sizeof(sqe));
+	sqe.opcode = IORING_OP_OPENAT;
+	sqe.fd = AT_FDCWD;
+	sqe.addr = (uintptr_t)path;
+	sqe.len = mode;
+	sqe.open_flags = (__u32)flags;
+
+	b6b_uring_timeout(&ts, timeout - elapsed);
+	return b6b_uring_call(interp, &sqe, &ts, res);
+}
+
+int b6b_uring_poll(struct b6b_interp *interp,
+                   const int fd,
+                   const unsigned int events,
+                   const int timeout,
+                   int *res)
+{
+	struct io_uring_sqe sqe;
+	struct __kernel_timespec ts;
+
+	memset(&sqe, 0, sizeof(sqe));
+	sqe.opcode = IORING_OP_POLL_ADD;
+	sqe.fd = fd;
+	sqe.poll32_events = events;
+
+	if (timeout < 0)
+		return b6b_uring_call(interp, &sqe, NULL, res);
+
+	ts.tv_sec = timeout / 1000;
+	ts.tv_nsec = (timeout % 1000) * 1000000;
+	return b6b_uring_call(interp, &sqe, &ts, res);
+}
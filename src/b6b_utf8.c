@@ -0,0 +1,312 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2026 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef __SSE2__
+#	include <emmintrin.h>
+#endif
+
+#include <b6b.h>
+
+/* the sparse code point index stores the offset of every B6B_UTF8_STRIDE-th
+ * code point, so looking up a code point requires decoding at most
+ * B6B_UTF8_STRIDE - 1 sequences */
+#define B6B_UTF8_STRIDE 64
+
+struct b6b_utf8_idx {
+	struct b6b_cache cache;
+	size_t len;
+	size_t offs[];
+};
+
+/* returns the length of the ASCII prefix of a buffer */
+static size_t b6b_utf8_ascii(const unsigned char *s, const size_t len)
+{
+	size_t i = 0;
+#ifdef __SSE2__
+	int m;
+
+	for (; i + sizeof(__m128i) <= len; i += sizeof(__m128i)) {
+		m = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)&s[i]));
+		if (m)
+			return i + __builtin_ctz(m);
+	}
+#else
+	uint64_t w;
+
+	for (; i + sizeof(w) <= len; i += sizeof(w)) {
+		memcpy(&w, &s[i], sizeof(w));
+		if (w & UINT64_C(0x8080808080808080))
+			break;
+	}
+#endif
+
+	while ((i < len) && (s[i] < 0x80))
+		++i;
+
+	return i;
+}
+
+/* returns the length of a non-ASCII UTF-8 sequence, or 0 if it's invalid,
+ * overlong, a surrogate or beyond U+10FFFF */
+static size_t b6b_utf8_seq(const unsigned char *s, const size_t len)
+{
+	if (s[0] < 0xC2)
+		return 0;
+
+	if (s[0] < 0xE0) {
+		if ((len < 2) || ((s[1] & 0xC0) != 0x80))
+			return 0;
+
+		return 2;
+	}
+
+	if (s[0] < 0xF0) {
+		if ((len < 3) ||
+		    ((s[1] & 0xC0) != 0x80) ||
+		    ((s[2] & 0xC0) != 0x80) ||
+		    ((s[0] == 0xE0) && (s[1] < 0xA0)) ||
+		    ((s[0] == 0xED) && (s[1] >= 0xA0)))
+			return 0;
+
+		return 3;
+	}
+
+	if ((s[0] > 0xF4) ||
+	    (len < 4) ||
+	    ((s[1] & 0xC0) != 0x80) ||
+	    ((s[2] & 0xC0) != 0x80) ||
+	    ((s[3] & 0xC0) != 0x80) ||
+	    ((s[0] == 0xF0) && (s[1] < 0x90)) ||
+	    ((s[0] == 0xF4) && (s[1] >= 0x90)))
+		return 0;
+
+	return 4;
+}
+
+int b6b_utf8_validate(const char *s, const size_t len, int *ascii)
+{
+	const unsigned char *p = (const unsigned char *)s, *end = p + len;
+	size_t n;
+
+	*ascii = 1;
+
+	do {
+		/* skip ASCII characters in bulk */
+		p += b6b_utf8_ascii(p, end - p);
+		if (p == end)
+			return 1;
+
+		*ascii = 0;
+
+		n = b6b_utf8_seq(p, end - p);
+		if (!n)
+			return 0;
+
+		p += n;
+	} while (1);
+}
+
+int b6b_as_utf8(struct b6b_obj *o)
+{
+	int ascii;
+
+	if (!b6b_as_str(o))
+		return 0;
+
+	if (o->flags & B6B_STR_UTF8)
+		return 1;
+
+	if (!b6b_utf8_validate(o->s, o->slen, &ascii))
+		return 0;
+
+	o->flags |= ascii ? (B6B_STR_UTF8 | B6B_STR_ASCII) : B6B_STR_UTF8;
+	return 1;
+}
+
+static void b6b_utf8_idx_del(void *priv)
+{
+	free(priv);
+}
+
+static struct b6b_utf8_idx *b6b_utf8_idx_new(const char *s, const size_t len)
+{
+	struct b6b_utf8_idx *idx;
+	const unsigned char *p = (const unsigned char *)s;
+	size_t i, n, cp = 0;
+
+	/* count the code points, by counting bytes that don't continue a
+	 * sequence */
+	for (i = 0; i < len; ++i) {
+		if ((p[i] & 0xC0) != 0x80)
+			++cp;
+	}
+
+	n = (cp + B6B_UTF8_STRIDE - 1) / B6B_UTF8_STRIDE;
+	idx = (struct b6b_utf8_idx *)malloc(sizeof(*idx) + sizeof(idx->offs[0]) * n);
+	if (!b6b_allocated(idx))
+		return NULL;
+
+	idx->len = cp;
+
+	for (cp = 0, i = 0; i < len; ++cp, i += b6b_utf8_cplen(p[i])) {
+		if (!(cp % B6B_UTF8_STRIDE))
+			idx->offs[cp / B6B_UTF8_STRIDE] = i;
+	}
+
+	return idx;
+}
+
+/* the index is cached on the string, until it changes */
+static struct b6b_utf8_idx *b6b_utf8_idx_get(struct b6b_obj *o)
+{
+	struct b6b_utf8_idx *idx;
+
+	idx = (struct b6b_utf8_idx *)b6b_cache_get(o, b6b_utf8_idx_del);
+	if (idx)
+		return idx;
+
+	idx = b6b_utf8_idx_new(o->s, o->slen);
+	if (idx)
+		b6b_cache_add(o, &idx->cache, b6b_utf8_idx_del);
+
+	return idx;
+}
+
+static size_t b6b_utf8_off(const struct b6b_utf8_idx *idx,
+                           const char *s,
+                           size_t i)
+{
+	size_t off = idx->offs[i / B6B_UTF8_STRIDE];
+
+	for (i %= B6B_UTF8_STRIDE; i; --i)
+		off += b6b_utf8_cplen((unsigned char)s[off]);
+
+	return off;
+}
+
+static enum b6b_res b6b_utf8_proc_ulen(struct b6b_interp *interp,
+                                       struct b6b_obj *args)
+{
+	struct b6b_obj *s;
+	struct b6b_utf8_idx *idx;
+
+	if (!b6b_proc_get_args(interp, args, "os", NULL, &s) || !b6b_as_utf8(s))
+		return B6B_ERR;
+
+	if (s->flags & B6B_STR_ASCII)
+		return b6b_return_int(interp, (b6b_int)s->slen);
+
+	idx = b6b_utf8_idx_get(s);
+	if (!idx)
+		return B6B_ERR;
+
+	return b6b_return_int(interp, (b6b_int)idx->len);
+}
+
+static enum b6b_res b6b_utf8_proc_uindex(struct b6b_interp *interp,
+                                         struct b6b_obj *args)
+{
+	struct b6b_obj *s, *i;
+	struct b6b_utf8_idx *idx;
+	size_t off;
+
+	if (!b6b_proc_get_args(interp, args, "osi", NULL, &s, &i) ||
+	    (i->i < 0) ||
+	    !b6b_as_utf8(s))
+		return B6B_ERR;
+
+	if (s->flags & B6B_STR_ASCII) {
+		if (i->i >= s->slen)
+			return B6B_ERR;
+
+		return b6b_return_str(interp, &s->s[i->i], 1);
+	}
+
+	idx = b6b_utf8_idx_get(s);
+	if (!idx)
+		return B6B_ERR;
+
+	if (i->i >= idx->len)
+		return B6B_ERR;
+
+	off = b6b_utf8_off(idx, s->s, (size_t)i->i);
+	return b6b_return_str(interp,
+	                      &s->s[off],
+	                      b6b_utf8_cplen((unsigned char)s->s[off]));
+}
+
+static enum b6b_res b6b_utf8_proc_urange(struct b6b_interp *interp,
+                                         struct b6b_obj *args)
+{
+	struct b6b_obj *s, *start, *end;
+	struct b6b_utf8_idx *idx;
+	size_t soff, eoff;
+
+	if (!b6b_proc_get_args(interp, args, "osii", NULL, &s, &start, &end) ||
+	    (start->i < 0) ||
+	    (end->i < 0) ||
+	    (start->i > end->i) ||
+	    !b6b_as_utf8(s))
+		return B6B_ERR;
+
+	if (s->flags & B6B_STR_ASCII) {
+		if (end->i >= s->slen)
+			return B6B_ERR;
+
+		return b6b_return_str(interp,
+		                      &s->s[start->i],
+		                      (size_t)(end->i - start->i + 1));
+	}
+
+	idx = b6b_utf8_idx_get(s);
+	if (!idx)
+		return B6B_ERR;
+
+	if (end->i >= idx->len)
+		return B6B_ERR;
+
+	soff = b6b_utf8_off(idx, s->s, (size_t)start->i);
+	eoff = b6b_utf8_off(idx, s->s, (size_t)end->i);
+	eoff += b6b_utf8_cplen((unsigned char)s->s[eoff]);
+	return b6b_return_str(interp, &s->s[soff], eoff - soff);
+}
+
+static const struct b6b_ext_obj b6b_utf8[] = {
+	{
+		.name = "str.ulen",
+		.type = B6B_TYPE_STR,
+		.val.s = "str.ulen",
+		.proc = b6b_utf8_proc_ulen
+	},
+	{
+		.name = "str.uindex",
+		.type = B6B_TYPE_STR,
+		.val.s = "str.uindex",
+		.proc = b6b_utf8_proc_uindex
+	},
+	{
+		.name = "str.urange",
+		.type = B6B_TYPE_STR,
+		.val.s = "str.urange",
+		.proc = b6b_utf8_proc_urange
+	}
+};
+__b6b_ext(b6b_utf8);
@@ -31,11 +31,61 @@
 
 struct b6b_zlib_deflate_data {
 	mz_stream strm;
+	unsigned char *src;
+	unsigned char *dst;
+	size_t slen;
+	size_t max;
+	size_t head;
+	size_t foot;
+	void (*finish)(const unsigned char *,
+	               const size_t,
+	               const unsigned char *,
+	               const size_t,
+	               const int);
+	int level;
 	mz_uint rem;
+	int ok;
+};
+
+struct b6b_zlib_inflate_data {
+	mz_stream strm;
 	size_t slen;
+	size_t dlen;
+	unsigned char *src;
+	unsigned char *dst;
+	mz_uint rem;
 	int ok;
 };
 
+union b6b_zlib_data {
+	struct b6b_zlib_deflate_data deflate;
+	struct b6b_zlib_inflate_data inflate;
+};
+
+/* a compression or decompression operation, split into a preparation stage
+ * that copies the input, a stage that may run in an offload thread and a stage
+ * that frees everything and returns the output */
+struct b6b_zlib_op {
+	const char *name;
+	int (*init)(union b6b_zlib_data *,
+	            const struct b6b_zlib_op *,
+	            const struct b6b_obj *,
+	            const int);
+	void (*fn)(void *);
+	struct b6b_obj *(*end)(union b6b_zlib_data *);
+	int wbits;
+	size_t head;
+	size_t foot;
+	void (*finish)(const unsigned char *,
+	               const size_t,
+	               const unsigned char *,
+	               const size_t,
+	               const int);
+	size_t (*get_size)(const unsigned char *, const size_t);
+	/* set if the operation accepts a compression level */
+	int level;
+};
+
 static void b6b_zlib_do_deflate(void *arg)
 {
 	struct b6b_zlib_deflate_data *data = (struct b6b_zlib_deflate_data *)arg;
@@ -52,118 +102,97 @@ static void b6b_zlib_do_deflate(void *arg)
 		data->rem = (mz_uint)data->slen - data->strm.total_in;
 	}
 
+	if ((mz_deflate(&data->strm, MZ_FINISH) != MZ_STREAM_END) ||
+	    (data->strm.total_out > data->max))
+		return;
+
+	if (data->finish)
+		data->finish(data->src,
+		             data->slen,
+		             data->dst,
+		             (size_t)data->strm.total_out,
+		             data->level);
+
 	data->ok = 1;
 }
 
-static enum b6b_res b6b_zlib_deflate(struct b6b_interp *interp,
-                                     struct b6b_obj *args,
-                                     const int wbits,
-                                     const size_t head,
-                                     const size_t foot,
-                                     void (*finish)(const unsigned char *,
-                                                    const size_t,
-                                                    const unsigned char *,
-                                                    const size_t,
-                                                    const int))
+static int b6b_zlib_deflate_init(union b6b_zlib_data *u,
+                                 const struct b6b_zlib_op *op,
+                                 const struct b6b_obj *s,
+                                 const int level)
 {
-	struct b6b_zlib_deflate_data data = {.strm = {0}};
-	size_t dlen, max, tot;
-	struct b6b_obj *s, *l, *o;
-	unsigned char *src, *dst;
-	int level = MZ_DEFAULT_COMPRESSION;
-
-	switch (b6b_proc_get_args(interp, args, "os|i", NULL, &s, &l)) {
-		case 3:
-			if ((l->i < INT_MIN) || (l->i > INT_MAX))
-				return B6B_ERR;
-			level = (int)l->i;
-
-		case 2:
-			break;
-
-		default:
-			return B6B_ERR;
-	}
+	struct b6b_zlib_deflate_data *data = &u->deflate;
+	size_t dlen;
 
-	max = UINT32_MAX - head - foot;
-	if (s->slen > max)
-		return B6B_ERR;
+	data->max = UINT32_MAX - op->head - op->foot;
+	if (s->slen > data->max)
+		return 0;
 
-	if (mz_deflateInit2(&data.strm,
+	memset(&data->strm, 0, sizeof(data->strm));
+	if (mz_deflateInit2(&data->strm,
 	                    level,
 	                    MZ_DEFLATED,
-	                    wbits,
+	                    op->wbits,
 	                    9,
 	                    MZ_DEFAULT_STRATEGY) != MZ_OK)
-		return B6B_ERR;
+		return 0;
 
-	data.slen = s->slen;
-	dlen = (size_t)mz_deflateBound(&data.strm, (mz_ulong)data.slen);
-	if (dlen >= max) {
-		mz_deflateEnd(&data.strm);
-		return B6B_ERR;
+	data->slen = s->slen;
+	dlen = (size_t)mz_deflateBound(&data->strm, (mz_ulong)data->slen);
+	if (dlen >= data->max) {
+		mz_deflateEnd(&data->strm);
+		return 0;
 	}
 
 	/* copy the buffer, since s->s may be freed after context switch */
-	src = (unsigned char *)malloc(data.slen);
-	if (!b6b_allocated(src)) {
-		mz_deflateEnd(&data.strm);
-		return B6B_ERR;
+	data->src = (unsigned char *)malloc(data->slen);
+	if (!b6b_allocated(data->src)) {
+		mz_deflateEnd(&data->strm);
+		return 0;
 	}
 
-	dst = (unsigned char *)malloc(dlen + head + foot + 1);
-	if (!b6b_allocated(dst)) {
-		free(src);
-		mz_deflateEnd(&data.strm);
-		return B6B_ERR;
+	data->dst = (unsigned char *)malloc(dlen + op->head + op->foot + 1);
+	if (!b6b_allocated(data->dst)) {
+		free(data->src);
+		mz_deflateEnd(&data->strm);
+		return 0;
 	}
 
-	memcpy(src, s->s, data.slen);
+	memcpy(data->src, s->s, data->slen);
 
-	data.strm.next_in = src;
+	data->strm.next_in = data->src;
 	/* compressed data should start after the header and mz_deflate() does not
 	 * know about the extra room for the footer */
-	data.strm.next_out = dst + head;
-	data.strm.avail_out = (mz_uint32)dlen;
-
-	data.rem = (mz_uint)data.slen;
-	data.ok = 0;
-	if (!b6b_offload(interp, b6b_zlib_do_deflate, &data) ||
-	    !data.ok ||
-	    (mz_deflate(&data.strm, MZ_FINISH) != MZ_STREAM_END) ||
-	    (data.strm.total_out > max)) {
-		free(dst);
-		free(src);
-		mz_deflateEnd(&data.strm);
-		return B6B_ERR;
-	}
-
-	if (finish)
-		finish(src, data.slen, dst, (size_t)data.strm.total_out, level);
-
-	free(src);
-	tot = (size_t)(data.strm.total_out + head + foot);
-	dst[tot] = '\0';
-	o = b6b_str_new((char *)dst, tot);
-	mz_deflateEnd(&data.strm);
-	if (b6b_unlikely(!o)) {
-		free(dst);
-		return B6B_ERR;
-	}
-
-	return b6b_return(interp, o);
+	data->strm.next_out = data->dst + op->head;
+	data->strm.avail_out = (mz_uint32)dlen;
+
+	data->head = op->head;
+	data->foot = op->foot;
+	data->finish = op->finish;
+	data->level = level;
+	data->rem = (mz_uint)data->slen;
+	data->ok = 0;
+	return 1;
 }
 
-static enum b6b_res b6b_zlib_proc_deflate(struct b6b_interp *interp,
-                                          struct b6b_obj *args)
+static struct b6b_obj *b6b_zlib_deflate_end(union b6b_zlib_data *u)
 {
-	return b6b_zlib_deflate(interp, args, -MZ_DEFAULT_WINDOW_BITS, 0, 0, NULL);
-}
+	struct b6b_zlib_deflate_data *data = &u->deflate;
+	struct b6b_obj *o = NULL;
+	size_t tot;
+
+	if (data->ok) {
+		tot = (size_t)(data->strm.total_out + data->head + data->foot);
+		data->dst[tot] = '\0';
+		o = b6b_str_new((char *)data->dst, tot);
+	}
 
-static enum b6b_res b6b_zlib_proc_compress(struct b6b_interp *interp,
-                                           struct b6b_obj *args)
-{
-	return b6b_zlib_deflate(interp, args, MZ_DEFAULT_WINDOW_BITS, 0, 0, NULL);
+	if (!o)
+		free(data->dst);
+
+	free(data->src);
+	mz_deflateEnd(&data->strm);
+	return o;
 }
 
 struct gzip_hdr {
@@ -214,26 +243,6 @@ static void b6b_zlib_gzip_finish(const unsigned char *buf,
 	ftr->len = (uint32_t)(len % UINT32_MAX);
 }
 
-static enum b6b_res b6b_zlib_proc_gzip(struct b6b_interp *interp,
-                                       struct b6b_obj *args)
-{
-	return b6b_zlib_deflate(interp,
-	                        args,
-	                        -MZ_DEFAULT_WINDOW_BITS,
-	                        sizeof(struct gzip_hdr),
-	                        sizeof(struct gzip_ftr),
-	                        b6b_zlib_gzip_finish);
-}
-
-struct b6b_zlib_inflate_data {
-	mz_stream strm;
-	size_t slen;
-	size_t dlen;
-	unsigned char *dst;
-	mz_uint rem;
-	int ok;
-};
-
 static void b6b_zlib_do_inflate(void *arg)
 {
 	struct b6b_zlib_inflate_data *data = (struct b6b_zlib_inflate_data *)arg;
@@ -245,7 +254,8 @@ static void b6b_zlib_do_inflate(void *arg)
 				break;
 
 			case MZ_STREAM_END:
-				data->ok = 1;
+				if (mz_inflate(&data->strm, MZ_FINISH) == MZ_STREAM_END)
+					data->ok = 1;
 				return;
 
 			default:
@@ -274,110 +284,322 @@ static void b6b_zlib_do_inflate(void *arg)
 	} while (1);
 }
 
-static enum b6b_res b6b_zlib_inflate(struct b6b_interp *interp,
-                                     struct b6b_obj *args,
-                                     const int wbits,
-                                     const size_t head,
-                                     const size_t foot,
-                                     size_t (*get_size)(const unsigned char *,
-                                                        const size_t))
+static int b6b_zlib_inflate_init(union b6b_zlib_data *u,
+                                 const struct b6b_zlib_op *op,
+                                 const struct b6b_obj *s,
+                                 const int level)
 {
-	struct b6b_zlib_inflate_data data = {.strm = {0}};
-	struct b6b_obj *s, *o;
+	struct b6b_zlib_inflate_data *data = &u->inflate;
 	size_t junk;
-	unsigned char *src;
-
-	if (!b6b_proc_get_args(interp, args, "os", NULL, &s))
-		return B6B_ERR;
 
-	junk = head + foot;
+	junk = op->head + op->foot;
 	if ((s->slen > UINT32_MAX) || (s->slen <= junk))
-		return B6B_ERR;
-
-	if (get_size) {
-		data.dlen = get_size((const unsigned char *)s->s, s->slen);
-		if (data.dlen == 0) {
-			data.dlen = 1;
-		} else if (data.dlen == SIZE_MAX)
-			return B6B_ERR;
+		return 0;
+
+	if (op->get_size) {
+		data->dlen = op->get_size((const unsigned char *)s->s, s->slen);
+		if (data->dlen == 0) {
+			data->dlen = 1;
+		} else if (data->dlen == SIZE_MAX)
+			return 0;
 	} else
-		data.dlen = B6B_INFLATE_OUT_CHUNK_SZ;
+		data->dlen = B6B_INFLATE_OUT_CHUNK_SZ;
 
-	if (mz_inflateInit2(&data.strm, wbits) != MZ_OK)
-		return B6B_ERR;
+	memset(&data->strm, 0, sizeof(data->strm));
+	if (mz_inflateInit2(&data->strm, op->wbits) != MZ_OK)
+		return 0;
 
-	data.dst = (unsigned char *)malloc(data.dlen + 1);
-	if (!data.dst) {
-		mz_inflateEnd(&data.strm);
-		return B6B_ERR;
+	data->dst = (unsigned char *)malloc(data->dlen + 1);
+	if (!data->dst) {
+		mz_inflateEnd(&data->strm);
+		return 0;
 	}
 
-	data.slen = s->slen - junk;
-	src = (unsigned char *)malloc(data.slen);
-	if (!b6b_allocated(src)) {
-		free(data.dst);
-		mz_inflateEnd(&data.strm);
-		return B6B_ERR;
+	data->slen = s->slen - junk;
+	data->src = (unsigned char *)malloc(data->slen);
+	if (!b6b_allocated(data->src)) {
+		free(data->dst);
+		mz_inflateEnd(&data->strm);
+		return 0;
 	}
-	memcpy(src, s->s + head, data.slen);
-
-	data.strm.next_in = src;
-	data.strm.next_out = data.dst;
-	data.strm.avail_in = data.slen;
-	data.strm.avail_out = data.dlen;
-
-	data.rem = (mz_uint)data.slen;
-	data.ok = 0;
-	if (!b6b_offload(interp, b6b_zlib_do_inflate, &data) ||
-	    !data.ok ||
-	    (mz_inflate(&data.strm, MZ_FINISH) != MZ_STREAM_END)) {
-		free(data.dst);
-		free(src);
-		mz_inflateEnd(&data.strm);
-		return B6B_ERR;
+	memcpy(data->src, s->s + op->head, data->slen);
+
+	data->strm.next_in = data->src;
+	data->strm.next_out = data->dst;
+	data->strm.avail_in = data->slen;
+	data->strm.avail_out = data->dlen;
+
+	data->rem = (mz_uint)data->slen;
+	data->ok = 0;
+	return 1;
+}
+
+static struct b6b_obj *b6b_zlib_inflate_end(union b6b_zlib_data *u)
+{
+	struct b6b_zlib_inflate_data *data = &u->inflate;
+	struct b6b_obj *o = NULL;
+
+	if (data->ok) {
+		data->dst[data->strm.total_out] = '\0';
+		o = b6b_str_new((char *)data->dst, (size_t)data->strm.total_out);
 	}
 
-	free(src);
-	data.dst[data.strm.total_out] = '\0';
-	o = b6b_str_new((char *)data.dst, (size_t)data.strm.total_out);
-	mz_inflateEnd(&data.strm);
-	if (b6b_unlikely(!o)) {
-		free(data.dst);
-		return B6B_ERR;
+	if (!o)
+		free(data->dst);
+
+	free(data->src);
+	mz_inflateEnd(&data->strm);
+	return o;
+}
+
+static size_t b6b_zlib_gzip_get_size(const unsigned char *buf,
+                                     const size_t len)
+{
+	struct gzip_ftr *ftr = (struct gzip_ftr *)(buf + len - sizeof(*ftr));
+
+	return (size_t)ftr->len;
+}
+
+static const struct b6b_zlib_op b6b_zlib_ops[] = {
+	{
+		.name = "deflate",
+		.init = b6b_zlib_deflate_init,
+		.fn = b6b_zlib_do_deflate,
+		.end = b6b_zlib_deflate_end,
+		.wbits = -MZ_DEFAULT_WINDOW_BITS,
+		.level = 1
+	},
+	{
+		.name = "compress",
+		.init = b6b_zlib_deflate_init,
+		.fn = b6b_zlib_do_deflate,
+		.end = b6b_zlib_deflate_end,
+		.wbits = MZ_DEFAULT_WINDOW_BITS,
+		.level = 1
+	},
+	{
+		.name = "gzip",
+		.init = b6b_zlib_deflate_init,
+		.fn = b6b_zlib_do_deflate,
+		.end = b6b_zlib_deflate_end,
+		.wbits = -MZ_DEFAULT_WINDOW_BITS,
+		.head = sizeof(struct gzip_hdr),
+		.foot = sizeof(struct gzip_ftr),
+		.finish = b6b_zlib_gzip_finish,
+		.level = 1
+	},
+	{
+		.name = "inflate",
+		.init = b6b_zlib_inflate_init,
+		.fn = b6b_zlib_do_inflate,
+		.end = b6b_zlib_inflate_end,
+		.wbits = -MZ_DEFAULT_WINDOW_BITS
+	},
+	{
+		.name = "decompress",
+		.init = b6b_zlib_inflate_init,
+		.fn = b6b_zlib_do_inflate,
+		.end = b6b_zlib_inflate_end,
+		.wbits = MZ_DEFAULT_WINDOW_BITS
+	},
+	{
+		.name = "gunzip",
+		.init = b6b_zlib_inflate_init,
+		.fn = b6b_zlib_do_inflate,
+		.end = b6b_zlib_inflate_end,
+		.wbits = -MZ_DEFAULT_WINDOW_BITS,
+		.head = sizeof(struct gzip_hdr),
+		.foot = sizeof(struct gzip_ftr),
+		.get_size = b6b_zlib_gzip_get_size
 	}
+};
+
+static int b6b_zlib_get_level(const struct b6b_obj *l, int *level)
+{
+	if ((l->i < INT_MIN) || (l->i > INT_MAX))
+		return 0;
+
+	*level = (int)l->i;
+	return 1;
+}
+
+static enum b6b_res b6b_zlib_call(struct b6b_interp *interp,
+                                  struct b6b_obj *args,
+                                  const struct b6b_zlib_op *op)
+{
+	union b6b_zlib_data data;
+	struct b6b_obj *s, *l, *o;
+	int level = MZ_DEFAULT_COMPRESSION;
+
+	switch (b6b_proc_get_args(interp,
+	                          args,
+	                          op->level ? "os|i" : "os",
+	                          NULL,
+	                          &s,
+	                          &l)) {
+		case 3:
+			if (!b6b_zlib_get_level(l, &level))
+				return B6B_ERR;
+
+		case 2:
+			break;
+
+		default:
+			return B6B_ERR;
+	}
+
+	if (!op->init(&data, op, s, level))
+		return B6B_ERR;
+
+	/* if b6b_offload() fails, the job does not run and op->end() fails */
+	b6b_offload(interp, op->fn, &data);
+	o = op->end(&data);
+	if (!o)
+		return B6B_ERR;
 
 	return b6b_return(interp, o);
 }
 
+static enum b6b_res b6b_zlib_proc_deflate(struct b6b_interp *interp,
+                                          struct b6b_obj *args)
+{
+	return b6b_zlib_call(interp, args, &b6b_zlib_ops[0]);
+}
+
+static enum b6b_res b6b_zlib_proc_compress(struct b6b_interp *interp,
+                                           struct b6b_obj *args)
+{
+	return b6b_zlib_call(interp, args, &b6b_zlib_ops[1]);
+}
+
+static enum b6b_res b6b_zlib_proc_gzip(struct b6b_interp *interp,
+                                       struct b6b_obj *args)
+{
+	return b6b_zlib_call(interp, args, &b6b_zlib_ops[2]);
+}
+
 static enum b6b_res b6b_zlib_proc_inflate(struct b6b_interp *interp,
                                           struct b6b_obj *args)
 {
-	return b6b_zlib_inflate(interp, args, -MZ_DEFAULT_WINDOW_BITS, 0, 0, NULL);
+	return b6b_zlib_call(interp, args, &b6b_zlib_ops[3]);
 }
 
 static enum b6b_res b6b_zlib_proc_decompress(struct b6b_interp *interp,
                                              struct b6b_obj *args)
 {
-	return b6b_zlib_inflate(interp, args, MZ_DEFAULT_WINDOW_BITS, 0, 0, NULL);
+	return b6b_zlib_call(interp, args, &b6b_zlib_ops[4]);
 }
 
-static size_t b6b_zlib_gzip_get_size(const unsigned char *buf,
-                                     const size_t len)
+static enum b6b_res b6b_zlib_proc_gunzip(struct b6b_interp *interp,
+                                         struct b6b_obj *args)
 {
-	struct gzip_ftr *ftr = (struct gzip_ftr *)(buf + len - sizeof(*ftr));
-
-	return (size_t)ftr->len;
+	return b6b_zlib_call(interp, args, &b6b_zlib_ops[5]);
 }
 
-static enum b6b_res b6b_zlib_proc_gunzip(struct b6b_interp *interp,
-                                             struct b6b_obj *args)
+static enum b6b_res b6b_zlib_proc_pmap(struct b6b_interp *interp,
+                                       struct b6b_obj *args)
 {
-	return b6b_zlib_inflate(interp,
-	                        args,
-	                        -MZ_DEFAULT_WINDOW_BITS,
-	                        sizeof(struct gzip_hdr),
-	                        sizeof(struct gzip_ftr),
-	                        b6b_zlib_gzip_get_size);
+	struct b6b_obj *p, *l, *lv, *r, *o;
+	struct b6b_litem *li;
+	const struct b6b_zlib_op *op = NULL;
+	union b6b_zlib_data *data;
+	void **ptrs;
+	size_t i, j, n = 0;
+	int level = MZ_DEFAULT_COMPRESSION;
+	unsigned int argc;
+
+	argc = b6b_proc_get_args(interp, args, "osl|i", NULL, &p, &l, &lv);
+	if (!argc)
+		return B6B_ERR;
+
+	/* only operations that don't touch the interpreter can run in parallel */
+	for (i = 0; i < sizeof(b6b_zlib_ops) / sizeof(b6b_zlib_ops[0]); ++i) {
+		if (strcmp(p->s, b6b_zlib_ops[i].name) == 0) {
+			op = &b6b_zlib_ops[i];
+			break;
+		}
+	}
+
+	if (!op ||
+	    ((argc == 4) && (!op->level || !b6b_zlib_get_level(lv, &level))))
+		return B6B_ERR;
+
+	for (li = b6b_list_first(l); li; li = b6b_list_next(li)) {
+		if (!b6b_as_str(li->o))
+			return B6B_ERR;
+
+		++n;
+	}
+
+	r = b6b_list_new();
+	if (b6b_unlikely(!r))
+		return B6B_ERR;
+
+	if (!n)
+		return b6b_return(interp, r);
+
+	if (n > SIZE_MAX / sizeof(*data)) {
+		b6b_destroy(r);
+		return B6B_ERR;
+	}
+
+	data = (union b6b_zlib_data *)malloc(sizeof(*data) * n);
+	if (!b6b_allocated(data)) {
+		b6b_destroy(r);
+		return B6B_ERR;
+	}
+
+	ptrs = (void **)malloc(sizeof(*ptrs) * n);
+	if (!b6b_allocated(ptrs)) {
+		free(data);
+		b6b_destroy(r);
+		return B6B_ERR;
+	}
+
+	for (i = 0, li = b6b_list_first(l); li; ++i, li = b6b_list_next(li)) {
+		if (!op->init(&data[i], op, li->o, level)) {
+			for (j = 0; j < i; ++j)
+				op->end(&data[j]);
+
+			free(ptrs);
+			free(data);
+			b6b_destroy(r);
+			return B6B_ERR;
+		}
+
+		ptrs[i] = &data[i];
+	}
+
+	/* if b6b_offload_batch() fails, some jobs don't run and their
+	 * op->end() fails */
+	b6b_offload_batch(interp, op->fn, ptrs, n);
+
+	/* free all jobs, even if one failed */
+	for (i = 0; i < n; ++i) {
+		o = op->end(&data[i]);
+		if (!o) {
+			if (r) {
+				b6b_destroy(r);
+				r = NULL;
+			}
+			continue;
+		}
+
+		if (r && b6b_unlikely(!b6b_list_add(r, o))) {
+			b6b_destroy(r);
+			r = NULL;
+		}
+
+		b6b_unref(o);
+	}
+
+	free(ptrs);
+	free(data);
+
+	if (!r)
+		return B6B_ERR;
+
+	return b6b_return(interp, r);
 }
 
 static const struct b6b_ext_obj b6b_zlib[] = {
@@ -416,6 +638,12 @@ static const struct b6b_ext_obj b6b_zlib[] = {
 		.type = B6B_TYPE_STR,
 		.val.s = "gunzip",
 		.proc = b6b_zlib_proc_gunzip
+	},
+	{
+		.name = "pmap",
+		.type = B6B_TYPE_STR,
+		.val.s = "pmap",
+		.proc = b6b_zlib_proc_pmap
 	}
 };
 __b6b_ext(b6b_zlib);
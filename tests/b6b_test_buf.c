@@ -0,0 +1,89 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2026 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include <b6b.h>
+
+int main()
+{
+	struct b6b_interp interp;
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$local b [$buf]}", 17) == B6B_OK);
+	assert(b6b_call_copy(&interp, "{$b len}", 8) == B6B_OK);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 0);
+	assert(b6b_call_copy(&interp, "{$b take}", 9) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(interp.fg->_->slen == 0);
+	assert(b6b_call_copy(&interp, "{$b consume 1}", 14) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$b bad}", 8) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$local b [$buf ab]}", 20) == B6B_OK);
+	assert(b6b_call_copy(&interp, "{$b append cd {} ef}", 20) == B6B_OK);
+	assert(b6b_call_copy(&interp, "{$b len}", 8) == B6B_OK);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 6);
+	assert(b6b_call_copy(&interp, "{$b find cd}", 12) == B6B_OK);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 2);
+	assert(b6b_call_copy(&interp, "{$b find cd 3}", 14) == B6B_OK);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == -1);
+	assert(b6b_call_copy(&interp, "{$b find x}", 11) == B6B_OK);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == -1);
+	assert(b6b_call_copy(&interp, "{$b range 1 3}", 14) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "bcd") == 0);
+	assert(b6b_call_copy(&interp, "{$b range 1 6}", 14) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$b take 3}", 11) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "abc") == 0);
+	assert(b6b_call_copy(&interp, "{$b consume 1}", 14) == B6B_OK);
+	assert(b6b_call_copy(&interp, "{$b find f}", 11) == B6B_OK);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 1);
+	assert(b6b_call_copy(&interp, "{$b take 3}", 11) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$b take}", 9) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "ef") == 0);
+	assert(b6b_call_copy(&interp, "{$b len}", 8) == B6B_OK);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 0);
+	b6b_interp_destroy(&interp);
+
+	/* appending many times should preserve all data */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$local b [$buf]}", 17) == B6B_OK);
+	assert(b6b_call_copy(&interp, "{$map i [$range 1 1000] {{$b append abcd} {$b consume 1} {$b append 1}}}", 72) == B6B_OK);
+	assert(b6b_call_copy(&interp, "{$b len}", 8) == B6B_OK);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 4000);
+	assert(b6b_call_copy(&interp, "{$b take 8}", 11) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "abcd1abc") == 0);
+	b6b_interp_destroy(&interp);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2026 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include <b6b.h>
+
+int main()
+{
+	struct b6b_interp interp;
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$chan 0}", 9) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$chan a}", 9) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$chan.select}", 14) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$chan.select a}", 16) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$global c [$chan]}", 19) == B6B_OK);
+	assert(b6b_call_copy(&interp, "{$c}", 4) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$c a}", 6) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$c send}", 9) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$c send a} {$c send b} {$return [$str.join {} [$list.new [$c recv] [$c recv]]]}", 80) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "ab") == 0);
+	assert(b6b_call_copy(&interp, "{$map i [$range 1 100] {{$c send $i}}} {$return [$c len]}", 57) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 100);
+	assert(b6b_call_copy(&interp, "{$map i [$range 1 99] {{$c recv}}} {$return [$c recv]}", 54) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 100);
+	/* no other thread can send */
+	assert(b6b_call_copy(&interp, "{$c recv}", 9) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global c [$chan]} {$c send a} {$c close} {$return [$c recv]}", 62) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "a") == 0);
+	assert(b6b_call_copy(&interp, "{$c recv}", 9) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$c send b}", 11) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$chan.select $c}", 17) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	/* the sender blocks while the channel is full */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	/* switch threads only when they yield or wait */
+	b6b_set_quantum(&interp, UINT64_MAX);
+	assert(b6b_call_copy(&interp, "{$global c [$chan 1]} {$global n 0} {$spawn {{$map i {a b c d} {{$c send $i} {$global n [$+ $n 1]}}}}} {$yield} {$yield} {$return $n}", 133) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 1);
+	assert(b6b_call_copy(&interp, "{$return [$str.join {} [$list.new [$c recv] [$c recv] [$c recv] [$c recv] $n]]}", 79) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "abcd4") == 0);
+	b6b_interp_destroy(&interp);
+
+	/* receivers are woken up in order */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global c [$chan]} {$global d [$chan]} {$spawn {{$d send [$str.join {} [$list.new a [$c recv]]]}}} {$yield} {$spawn {{$d send [$str.join {} [$list.new b [$c recv]]]}}} {$yield} {$c send 1} {$c send 2} {$return [$str.join { } [$list.new [$d recv] [$d recv]]]}", 259) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "a1 b2") == 0);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global a [$chan]} {$global b [$chan]} {$b send x} {$map {c v} [$chan.select $a $b] {{$c send $v}}} {$return [$b recv]}", 120) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "x") == 0);
+	assert(b6b_call_copy(&interp, "{$spawn {{$b send y}}} {$map {c v} [$chan.select $a $b] {{$c send $v}}} {$return [$b recv]}", 91) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "y") == 0);
+	assert(b6b_call_copy(&interp, "{$spawn {{$a send z}}} {$map {c v} [$chan.select $a $b] {{$c send $v}}} {$return [$a recv]}", 91) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "z") == 0);
+	/* a closed channel is skipped */
+	assert(b6b_call_copy(&interp, "{$a close} {$spawn {{$b send w}}} {$return [$list.index [$chan.select $a $b] 1]}", 80) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "w") == 0);
+	b6b_interp_destroy(&interp);
+
+	/* threads blocked on a channel exit with the interpreter */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global c [$chan 1]} {$spawn {{$c recv}}} {$spawn {{$c send a} {$c send b}}} {$spawn {{$chan.select $c [$chan]}}}", 114) == B6B_OK);
+	b6b_interp_destroy(&interp);
+
+	return EXIT_SUCCESS;
+}
@@ -27,6 +27,8 @@ int main()
 	struct b6b_interp interp;
 
 	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	/* switch threads after every statement */
+	b6b_set_quantum(&interp, 0);
 	assert(b6b_call_copy(
 	                &interp,
 	                "{$global x {}} " \
@@ -40,6 +42,8 @@ int main()
 	b6b_interp_destroy(&interp);
 
 	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	/* switch threads only when they yield or wait */
+	b6b_set_quantum(&interp, UINT64_MAX);
 	assert(b6b_call_copy(
 	                &interp,
 	                "{$global x {}} " \
@@ -61,6 +65,8 @@ int main()
 	b6b_interp_destroy(&interp);
 
 	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	/* switch threads after every statement */
+	b6b_set_quantum(&interp, 0);
 	assert(b6b_call_copy(
 	                &interp,
 	                "{$global x {}} " \
@@ -81,5 +87,23 @@ int main()
 	assert(!strstr(interp.fg->_->s, "b a"));
 	assert(!strstr(interp.fg->_->s, "c b"));
 	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$co}", 5) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	/* an error in a coroutine should not stop the next one */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp,
+	                     "{$global x {}} " \
+	                     "{$co {{$throw a} {$list.append $x a}}} " \
+	                     "{$co {{$list.append $x b}}} " \
+	                     "{$yield} " \
+	                     "{$return $x}",
+	                     15 + 39 + 28 + 9 + 12) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "b") == 0);
+	b6b_interp_destroy(&interp);
+
 	return EXIT_SUCCESS;
 }
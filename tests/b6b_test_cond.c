@@ -0,0 +1,63 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2026 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include <b6b.h>
+
+int main()
+{
+	struct b6b_interp interp;
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$cond a}", 9) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$global c [$cond]} {$global m [$mutex]}", 40) == B6B_OK);
+	assert(b6b_call_copy(&interp, "{$c}", 4) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$c a}", 6) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$c wait}", 9) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$c wait $c}", 12) == B6B_ERR);
+	/* the caller must hold the mutex */
+	assert(b6b_call_copy(&interp, "{$c wait $m}", 12) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$c signal} {$c broadcast}", 26) == B6B_OK);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global c [$cond]} {$global m [$mutex]} {$global ready 0} {$global f [$spawn {{$m lock} {$loop {{$if $ready {{$break}}} {$c wait $m}}} {$m unlock} {$return $ready}}]} {$yield} {$m lock} {$global ready 1} {$c signal} {$m unlock} {$return [$f wait]}", 248) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 1);
+	b6b_interp_destroy(&interp);
+
+	/* broadcast wakes up all waiting threads, signal wakes up one */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global c [$cond]} {$global m [$mutex]} {$global x {}} {$global fs [$map i {1 2 3} {{$spawn {{$m lock} {$c wait $m} {$list.append $x a} {$m unlock}}}}]} {$yield} {$c signal} {$yield} {$return [$list.len $x]}", 208) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 1);
+	assert(b6b_call_copy(&interp, "{$c broadcast} {$map f $fs {{$f wait}}} {$return [$list.len $x]}", 64) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 3);
+	b6b_interp_destroy(&interp);
+
+	/* threads waiting for a condition exit with the interpreter */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global c [$cond]} {$global m [$mutex]} {$spawn {{$m lock} {$c wait $m}}}", 74) == B6B_OK);
+	b6b_interp_destroy(&interp);
+
+	return EXIT_SUCCESS;
+}
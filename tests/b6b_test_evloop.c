@@ -0,0 +1,122 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2020 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include <b6b.h>
+
+int main()
+{
+	struct b6b_interp interp;
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{[$evloop] abc}", 15) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{[$evloop] after 0 {}}", 22) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	/* wait returns immediately if there are no streams */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{[$evloop] wait -1}", 19) == B6B_OK);
+	b6b_interp_destroy(&interp);
+
+	/* after fires once */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global x {}} {$global l [$evloop]} {$l after 0.1 [$proc _ {{$list.append $x a}}]} {$l after 0.05 [$proc _ {{$list.append $x b}}]} {$l wait -1} {$return [$str.join {} $x]}", 172) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "ba") == 0);
+	b6b_interp_destroy(&interp);
+
+	/* timers are called in order, even if they're far apart */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global x {}} {$global l [$evloop]} {$l after 0.9 [$proc _ {{$list.append $x c}}]} {$l after 0.001 [$proc _ {{$list.append $x a}}]} {$l after 0.2 [$proc _ {{$list.append $x b}}]} {$l wait -1} {$return [$str.join {} $x]}", 220) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "abc") == 0);
+	b6b_interp_destroy(&interp);
+
+	/* after returns a handle that cancels the timer */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global x {}} {$global l [$evloop]} {$global t [$l after 0.1 [$proc _ {{$list.append $x a}}]]} {$l after 0.05 [$proc _ {{$list.append $x b} {$t cancel}}]} {$l wait -1} {$t cancel} {$return [$str.join {} $x]}", 208) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "b") == 0);
+	assert(b6b_call_copy(&interp, "{$t abc}", 8) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	/* timers can be removed like streams, even by their own callback */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global x {}} {$global l [$evloop]} {$global t [$l every 0.01 [$proc _ {{$list.append $x a} {$if [$== [$list.len $x] 5] {{$l remove $t}}}}]]} {$l wait -1} {$return [$list.len $x]}", 180) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 5);
+	b6b_interp_destroy(&interp);
+
+	/* handles may outlive the event loop */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global l [$evloop]} {$global t [$l after 10 {}]} {$global l {}} {$t cancel}", 77) == B6B_OK);
+	b6b_interp_destroy(&interp);
+
+	/* many timers share one file descriptor */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global n 0} {$global l [$evloop]} {$map i [$range 1 2000] {{$l after [$/ $i 10000.0] [$proc _ {{$global n [$+ $n 1]}}]}}} {$l wait -1} {$return $n}", 149) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 2000);
+	b6b_interp_destroy(&interp);
+
+	/* every fires until the callback fails */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global x {}} {$global l [$evloop]} {$l every 0.05 [$proc _ {{$list.append $x a} {$if [$== [$list.len $x] 3] {{$throw}}}}]} {$l wait -1} {$return [$str.join {} $x]}", 165) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "aaa") == 0);
+	b6b_interp_destroy(&interp);
+
+	/* with -e, errors propagate */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE | B6B_OPT_RAISE));
+	assert(b6b_call_copy(&interp, "{$global l [$evloop]} {$l every 0.05 [$proc _ {{$throw}}]} {$l wait -1}", 71) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	/* handlers receive the stream and it's closed once removed */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global x {}} {$global l [$evloop]} {$map {a b} [$un.pair stream] {{$a write abc} {$l add $b [$proc _ {{$list.append $x [$1 read]} {$l remove $1}}] {} {}} {$l wait -1} {$return [$str.join {} $x]}}}", 198) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "abc") == 0);
+	b6b_interp_destroy(&interp);
+
+	/* the error handler is called when the peer is gone */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global x {}} {$global l [$evloop]} {$map {a b} [$un.pair stream] {{$a close} {$l add $b [$proc _ {{$list.append $x r}}] {} [$proc _ {{$list.append $x e}}]}}} {$l wait -1} {$return [$str.join {} $x]}", 200) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "e") == 0);
+	b6b_interp_destroy(&interp);
+
+	/* update replaces the handlers */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global x {}} {$global l [$evloop]} {$map {a b} [$un.pair stream] {{$a write abc} {$l add $b {} [$proc _ {{$list.append $x w} {$l update $1 [$proc _ {{$list.append $x [$1 read]} {$l remove $1}}] {} {}}}] {}} {$l wait -1} {$return [$str.join {} $x]}}}", 251) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "wabc") == 0);
+	b6b_interp_destroy(&interp);
+
+	/* a failing handler unregisters the stream */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global l [$evloop]} {$map {a b} [$un.pair stream] {{$a write abc} {$l add $b [$proc _ {{$throw}}] {} {}} {$l wait -1} {$b fd}}}", 129) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,78 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2026 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include <b6b.h>
+
+int main()
+{
+	struct b6b_interp interp;
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$mutex a}", 10) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$global m [$mutex]}", 20) == B6B_OK);
+	assert(b6b_call_copy(&interp, "{$m}", 4) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$m a}", 6) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$m unlock}", 11) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$m lock}", 9) == B6B_OK);
+	/* the mutex is not recursive */
+	assert(b6b_call_copy(&interp, "{$m lock}", 9) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$return [$m trylock]}", 22) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 0);
+	/* only the thread that holds the mutex can unlock it */
+	assert(b6b_call_copy(&interp, "{$global f [$spawn {{$m unlock}}]} {$f wait}", 44) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$m unlock}", 11) == B6B_OK);
+	assert(b6b_call_copy(&interp, "{$return [$m trylock]}", 22) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 1);
+	assert(b6b_call_copy(&interp, "{$m unlock}", 11) == B6B_OK);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	/* switch threads after every statement */
+	b6b_set_quantum(&interp, 0);
+	assert(b6b_call_copy(&interp, "{$global m [$mutex]} {$global x 0} {$global fs [$map i {1 2 3} {{$spawn {{$map j [$range 1 50] {{$m lock} {$global x [$+ $x 1]} {$m unlock}}}}}}]} {$map f $fs {{$f wait}}} {$return $x}", 184) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 150);
+	b6b_interp_destroy(&interp);
+
+	/* a mutex is released when the thread that holds it is done */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global m [$mutex]} {$global f [$spawn {{$m lock} {$throw a}}]} {$f wait}", 74) == B6B_ERR);
+	/* a new thread cannot unlock it, even if it reuses the old thread's memory */
+	assert(b6b_call_copy(&interp, "{$global g [$spawn {{$m unlock}}]} {$g wait}", 44) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$return [$m trylock]}", 22) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 1);
+	assert(b6b_call_copy(&interp, "{$m unlock}", 11) == B6B_OK);
+	assert(b6b_call_copy(&interp, "{$global a [$spawn {{$m lock} {$yield}}]} {$global b [$spawn {{$m lock} {$return 1}}]} {$return [$b wait]}", 106) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 1);
+	b6b_interp_destroy(&interp);
+
+	/* threads waiting for a mutex exit with the interpreter */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global m [$mutex]} {$m lock} {$spawn {{$m lock}}} {$spawn {{$m lock}}}", 72) == B6B_OK);
+	b6b_interp_destroy(&interp);
+
+	return EXIT_SUCCESS;
+}
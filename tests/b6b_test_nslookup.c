@@ -45,6 +45,16 @@ int main()
 	assert(!b6b_list_next(b6b_list_first(interp.fg->_)));
 	b6b_interp_destroy(&interp);
 
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$nslookup 127.0.0.1 0}", 23) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$nslookup 127.0.0.1 5}", 23) == B6B_OK);
+	assert(b6b_as_list(interp.fg->_));
+	assert(!b6b_list_empty(interp.fg->_));
+	b6b_interp_destroy(&interp);
+
 	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
 	assert(b6b_call_copy(&interp, "{$nslookup 127.0.0.1}", 21) == B6B_OK);
 	assert(b6b_as_list(interp.fg->_));
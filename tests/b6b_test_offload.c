@@ -17,19 +17,38 @@
  */
 
 #include <stdlib.h>
+#include <unistd.h>
 #include <assert.h>
+#include <errno.h>
 #include <string.h>
 
 #include <b6b.h>
 
+static atomic_int ndone = 0;
+static atomic_int ndel = 0;
+
+static void slow_job(void *arg)
+{
+	usleep(*(useconds_t *)arg);
+	atomic_fetch_add(&ndone, 1);
+}
+
+static void del_job(void *arg)
+{
+	atomic_fetch_add(&ndel, 1);
+}
+
 int main()
 {
+	useconds_t delay;
 	struct b6b_interp interp;
 	size_t i, bi = 0, ci = 0;
 	unsigned int times[2] = {0, 0};
 
 	/* output should be something like: cbacbacba */
 	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE | B6B_OPT_NO_POOL));
+	/* switch threads only when they yield or wait */
+	b6b_set_quantum(&interp, UINT64_MAX);
 	assert(b6b_call_copy(&interp, "{$global x {}} {$spawn {{$loop {{$sleep 0.1} {$list.append $x a}}}}} {$spawn {{$loop {{$sleep 0.1} {$list.append $x b}}}}} {$spawn {{$loop {{$sleep 0.1} {$list.append $x c}}}}} {$loop {{$if [$>= [$list.len $x] 9] {{$return [$str.join {} $x]}}} {$yield}}}", 254) == B6B_RET);
 	assert(b6b_as_str(interp.fg->_));
 	assert(interp.fg->_->slen >= 9);
@@ -39,6 +58,8 @@ int main()
 
 	/* output should be something like: babacbaba */
 	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE | B6B_OPT_NO_POOL));
+	/* switch threads only when they yield or wait */
+	b6b_set_quantum(&interp, UINT64_MAX);
 	assert(b6b_call_copy(&interp, "{$global x {}} {$spawn {{$loop {{$sleep 0.1} {$list.append $x a}}}}} {$spawn {{$loop {{$sleep 0.1} {$list.append $x b}}}}} {$spawn {{$map x {1 2 3} {{$sleep 0.1}}} {$list.append $x c} {$return}}} {$loop {{$if [$>= [$list.len $x] 9] {{$return [$str.join {} $x]}}} {$yield}}}", 273) == B6B_RET);
 	assert(b6b_as_str(interp.fg->_));
 	assert(interp.fg->_->slen > 3);
@@ -63,6 +84,8 @@ int main()
 
 	/* output should be something like: aaaacbaaa */
 	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE | B6B_OPT_NO_POOL));
+	/* switch threads only when they yield or wait */
+	b6b_set_quantum(&interp, UINT64_MAX);
 	assert(b6b_call_copy(&interp, "{$global x {}} {$spawn {{$loop {{$sleep 0.1} {$list.append $x a}}}}} {$spawn {{$map x {1 2 3 4 5} {{$sleep 0.1}}} {$list.append $x b} {$return}}} {$spawn {{$map x {1 2 3 4 5} {{$sleep 0.1}}} {$list.append $x c} {$return}}} {$loop {{$if [$>= [$list.len $x] 9] {{$return [$str.join {} $x]}}} {$yield}}}", 300) == B6B_RET);
 	assert(b6b_as_str(interp.fg->_));
 	assert(interp.fg->_->slen >= 9);
@@ -86,6 +109,8 @@ int main()
 
 	/* output should be something like: aabaacaaa */
 	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE | B6B_OPT_NO_POOL));
+	/* switch threads only when they yield or wait */
+	b6b_set_quantum(&interp, UINT64_MAX);
 	assert(b6b_call_copy(&interp, "{$global x {}} {$spawn {{$loop {{$sleep 0.1} {$list.append $x a}}}}} {$spawn {{$map x {1 2 3} {{$sleep 0.1}}} {$list.append $x b} {$return}}} {$spawn {{$map x {1 2 3 4 5} {{$sleep 0.1}}} {$list.append $x c} {$return}}} {$loop {{$if [$>= [$list.len $x] 9] {{$return [$str.join {} $x]}}} {$yield}}}", 296) == B6B_RET);
 	assert(b6b_as_str(interp.fg->_));
 	assert(interp.fg->_->slen >= 9);
@@ -109,6 +134,8 @@ int main()
 
 	/* output should be something like: acbd */
 	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE | B6B_OPT_NO_POOL));
+	/* switch threads only when they yield or wait */
+	b6b_set_quantum(&interp, UINT64_MAX);
 	assert(b6b_call_copy(&interp, "{$global x {}} {$spawn {{$loop {{$if [$list.len $x] {{$list.append $x b} {$return}}}}}}} {$spawn {{$loop {{$if [$list.len $x] {{$list.append $x c} {$return}}}}}}} {$list.append $x a} {$sleep 1} {$list.append $x d} {$return [$str.join {} $x]}", 241) == B6B_RET);
 	assert(b6b_as_str(interp.fg->_));
 	assert(interp.fg->_->slen == 4);
@@ -116,5 +143,95 @@ int main()
 	       (strcmp(interp.fg->_->s, "acbd") == 0));
 	b6b_interp_destroy(&interp);
 
+	/* more threads than offload threads and queue slots */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE | B6B_OPT_NO_POOL));
+	assert(b6b_call_copy(&interp, "{$global fs [$map i [$range 1 200] {{$spawn {{$return [$str.len [[$open /dev/zero rb] read 3]]}}}}]} {$return [$str.join {} [$map f $fs {{$f wait}}]]}", 150) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(interp.fg->_->slen == 200);
+	assert(strspn(interp.fg->_->s, "3") == 200);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	/* offload threads are spawned on first use */
+	assert(atomic_load(&interp.offpool.nthreads) == 0);
+	assert(interp.offpool.max == B6B_OFFLOAD_THREADS);
+	assert(b6b_call_copy(&interp, "{$global fs [$map i [$range 1 200] {{$spawn {{$return [$str.len [[$open /dev/zero rb] read 3]]}}}}]} {$return [$str.join {} [$map f $fs {{$f wait}}]]}", 150) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(interp.fg->_->slen == 200);
+	assert(strspn(interp.fg->_->s, "3") == 200);
+	assert(atomic_load(&interp.offpool.nthreads) > 0);
+	assert(atomic_load(&interp.offpool.nthreads) <= B6B_OFFLOAD_THREADS);
+	b6b_interp_destroy(&interp);
+
+	/* the pool size can be limited through the environment */
+	assert(setenv(B6B_OFFLOAD_THREADS_ENV, "2", 1) == 0);
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(interp.offpool.max == 2);
+	/* offload threads exit after a second without jobs */
+	interp.offpool.timeout = 1;
+	assert(b6b_call_copy(&interp, "{$global fs [$map i [$range 1 200] {{$spawn {{$return [$str.len [[$open /dev/zero rb] read 3]]}}}}]} {$return [$str.join {} [$map f $fs {{$f wait}}]]}", 150) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(interp.fg->_->slen == 200);
+	assert(strspn(interp.fg->_->s, "3") == 200);
+	assert(atomic_load(&interp.offpool.nthreads) > 0);
+	assert(atomic_load(&interp.offpool.nthreads) <= 2);
+	for (i = 0; (i < 30) && atomic_load(&interp.offpool.nthreads); ++i)
+		usleep(100000);
+	assert(atomic_load(&interp.offpool.nthreads) == 0);
+	/* the pool grows again once there's a job */
+	assert(b6b_call_copy(&interp, "{$global fs [$map i [$range 1 20] {{$spawn {{$return [$str.len [[$open /dev/zero rb] read 3]]}}}}]} {$return [$str.join {} [$map f $fs {{$f wait}}]]}", 149) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(interp.fg->_->slen == 20);
+	assert(strspn(interp.fg->_->s, "3") == 20);
+	assert(atomic_load(&interp.offpool.nthreads) > 0);
+	b6b_interp_destroy(&interp);
+
+	/* the limit is ignored if it's invalid */
+	assert(setenv(B6B_OFFLOAD_THREADS_ENV, "x", 1) == 0);
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(interp.offpool.max == B6B_OFFLOAD_THREADS);
+	b6b_interp_destroy(&interp);
+
+	assert(setenv(B6B_OFFLOAD_THREADS_ENV, "1000", 1) == 0);
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(interp.offpool.max == B6B_OFFLOAD_MAX);
+	b6b_interp_destroy(&interp);
+	assert(unsetenv(B6B_OFFLOAD_THREADS_ENV) == 0);
+
+	/* a job that's done before the deadline */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$spawn {{$sleep 2}}}", 21) == B6B_OK);
+	delay = 1000;
+	assert(b6b_offload_timeout(&interp, slow_job, &delay, del_job, 5000000000));
+	assert(atomic_load(&ndone) == 1);
+	assert(ndel == 0);
+	assert(interp.offpool.nabandoned == 0);
+
+	/* the waiting thread gives up and the job is freed once it's done; the
+	 * stuck offload thread doesn't count towards the limit */
+	delay = 500000;
+	assert(!b6b_offload_timeout(&interp, slow_job, &delay, del_job, 100000000));
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, strerror(ETIMEDOUT)) == 0);
+	assert(atomic_load(&ndone) == 1);
+	assert(ndel == 0);
+	assert(interp.offpool.nabandoned == 1);
+	assert(b6b_call_copy(&interp, "{$sleep 1}", 10) == B6B_OK);
+	assert(atomic_load(&ndone) == 2);
+	assert(ndel == 1);
+	assert(interp.offpool.nabandoned == 0);
+
+	/* the interpreter doesn't wait for jobs that timed out when it's
+	 * destroyed: they're left behind, and freed by the offload thread once
+	 * they're done */
+	assert(!b6b_offload_timeout(&interp, slow_job, &delay, del_job, 100000000));
+	assert(ndel == 1);
+	b6b_interp_destroy(&interp);
+	assert(atomic_load(&ndone) == 2);
+	assert(ndel == 1);
+	usleep(1000000);
+	assert(atomic_load(&ndone) == 3);
+	assert(ndel == 2);
+
 	return EXIT_SUCCESS;
 }
@@ -265,5 +265,45 @@ int main()
 	teardown("abc", 3);
 	b6b_interp_destroy(&interp);
 
+#ifdef B6B_HAVE_THREADS
+	/* files opened by multiple threads at the same time should behave like
+	 * files opened by one thread, with or without io_uring */
+	for (i = 0; i < 2; ++i) {
+		if (i)
+			assert(setenv("B6B_NO_IO_URING", "1", 1) == 0);
+
+		setup("abc", 3);
+		assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+		assert(b6b_call_copy(&interp, "{$global fs [$map i [$range 1 50] {{$spawn {{$return [[$open /tmp/.file r] read]}}}}]} {$return [$str.join {} [$map f $fs {{$f wait}}]]}", 136) == B6B_RET);
+		assert(b6b_as_str(interp.fg->_));
+		assert(interp.fg->_->slen == 150);
+		assert(strncmp(interp.fg->_->s, "abcabc", 6) == 0);
+		assert(b6b_call_copy(&interp, "{$global f [$spawn {{$open /tmp/.nonexistent r}}]} {$f wait}", 60) == B6B_ERR);
+		assert(b6b_call_copy(&interp, "{$global f [$spawn {{[$open /tmp/.file wu] write xyz}}]} {$f wait}", 66) == B6B_OK);
+		teardown("xyz", 3);
+		assert(b6b_call_copy(&interp, "{$global f [$spawn {{[$open /tmp/.file au] write abc}}]} {$f wait}", 66) == B6B_OK);
+		teardown("xyzabc", 6);
+		/* opening a FIFO blocks until there's a writer, so it should time
+		 * out, even though io_uring would open it without waiting */
+		assert((unlink("/tmp/.fifo") == 0) || (errno == ENOENT));
+		assert(mkfifo("/tmp/.fifo", 0600) == 0);
+		assert(b6b_call_copy(&interp, "{$global f [$spawn {{$open /tmp/.fifo r 0.1}}]} {$f wait}", 57) == B6B_ERR);
+		assert(b6b_as_str(interp.fg->_));
+		assert(strcmp(interp.fg->_->s, strerror(ETIMEDOUT)) == 0);
+		/* the fopen() never finishes, but the interpreter should not wait for
+		 * it when it exits */
+		assert(unlink("/tmp/.fifo") == 0);
+
+		assert(b6b_call_copy(&interp, "{$open /dev/null r 0}", 21) == B6B_ERR);
+		assert(b6b_call_copy(&interp, "{$open /dev/null r a}", 21) == B6B_ERR);
+#	ifdef B6B_HAVE_IO_URING
+		assert(!interp.uring.ok || (interp.uring.fd >= 0));
+		assert(!i || !interp.uring.ok);
+#	endif
+		b6b_interp_destroy(&interp);
+	}
+	assert(unsetenv("B6B_NO_IO_URING") == 0);
+#endif
+
 	return EXIT_SUCCESS;
 }
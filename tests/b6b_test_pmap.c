@@ -0,0 +1,95 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2020 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include <b6b.h>
+
+int main()
+{
+	struct b6b_interp interp;
+	const struct b6b_litem *li;
+	int i;
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$pmap}", 7) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$pmap $gzip}", 13) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$pmap $map {a b}}", 18) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$pmap $gunzip {a b} 9}", 23) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$pmap $gunzip {a b}}", 21) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$pmap $gzip {}}", 16) == B6B_OK);
+	assert(b6b_as_list(interp.fg->_));
+	assert(b6b_list_empty(interp.fg->_));
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$pmap $gunzip [$pmap $gzip {a bc def}]}", 40) == B6B_OK);
+	assert(b6b_as_list(interp.fg->_));
+	li = b6b_list_first(interp.fg->_);
+	assert(li);
+	assert(b6b_as_str(li->o));
+	assert(strcmp(li->o->s, "a") == 0);
+	li = b6b_list_next(li);
+	assert(li);
+	assert(b6b_as_str(li->o));
+	assert(strcmp(li->o->s, "bc") == 0);
+	li = b6b_list_next(li);
+	assert(li);
+	assert(b6b_as_str(li->o));
+	assert(strcmp(li->o->s, "def") == 0);
+	assert(!b6b_list_next(li));
+	b6b_interp_destroy(&interp);
+
+	/* results are identical to those of the sequential procedures */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global s [$str.join {} [$range 0 1000]]} {$return [$== [$list.index [$pmap $deflate [$list.new $s $s] 9] 1] [$deflate $s 9]]}", 127) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "1") == 0);
+	b6b_interp_destroy(&interp);
+
+	/* more jobs than queue slots, with and without a pool */
+	for (i = 0; i < 2; ++i) {
+		assert(b6b_interp_new_argv(&interp,
+		                           0,
+		                           NULL,
+		                           B6B_OPT_TRACE | (i ? B6B_OPT_NO_POOL : 0)));
+		assert(b6b_call_copy(&interp, "{$global l [$map x [$range 1 200] {{$str.join {} [$range 0 $x]}}]} {$return [$== [$pmap $decompress [$pmap $compress $l]] $l]}", 126) == B6B_RET);
+		assert(b6b_as_str(interp.fg->_));
+		assert(strcmp(interp.fg->_->s, "1") == 0);
+		b6b_interp_destroy(&interp);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -30,8 +30,12 @@
 int main()
 {
 	struct b6b_interp interp;
+	struct b6b_obj *o, *fd;
 	struct sockaddr_un sun = {.sun_family = AF_UNIX};
 	int s, c;
+#ifdef B6B_HAVE_THREADS
+	int i;
+#endif
 
 	s = socket(AF_UNIX, SOCK_STREAM, 0);
 	assert(s >= 0);
@@ -154,5 +158,89 @@ int main()
 
 	close(s);
 
+	/* results are reused once they're no longer referenced */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global p [$poll]} {$global ab [$un.pair stream]} {$global a [$list.index $ab 0]} {$global b [$list.index $ab 1]} {$p add [$b fd] $POLLIN} {$a write x}", 152) == B6B_OK);
+	assert(b6b_call_copy(&interp, "{$p wait 1 0}", 13) == B6B_OK);
+	o = interp.fg->_;
+	fd = b6b_list_first(b6b_list_first(o)->o)->o;
+	assert(b6b_call_copy(&interp, "{$b fd} {$p wait 1 0}", 21) == B6B_OK);
+	assert(interp.fg->_ == o);
+	assert(b6b_list_first(b6b_list_first(o)->o)->o == fd);
+	assert(b6b_call_copy(&interp, "{$global r [$p wait 1 0]} {$list.append [$list.index $r 0] y} {$p wait 1 0}", 75) == B6B_OK);
+	assert(interp.fg->_ != o);
+	assert(b6b_call_copy(&interp, "{$return [$list.len [$list.index $r 0]]}", 40) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 2);
+	assert(b6b_call_copy(&interp, "{$list.append [$list.index [$list.index $r 0] 0] y} {$return [$list.index [$list.index [$p wait 1 0] 0] 0]}", 107) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(b6b_call_copy(&interp, "{$return [$b fd]}", 17) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(b6b_call_copy(&interp, "{$return [$== [$list.index [$list.index [$p wait 1 0] 0] 0] [$b fd]]}", 69) == B6B_RET);
+	assert(b6b_obj_istrue(interp.fg->_));
+
+	/* mod changes the events of a registered fd */
+	assert(b6b_call_copy(&interp, "{$p mod [$a fd] $POLLIN}", 24) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$p mod -1 $POLLIN}", 19) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$p mod [$b fd] $POLLOUT} {$return [$p wait 1 0]}", 49) == B6B_RET);
+	assert(b6b_as_list(interp.fg->_));
+	assert(b6b_list_empty(b6b_list_first(interp.fg->_)->o));
+	assert(!b6b_list_empty(b6b_list_next(b6b_list_first(interp.fg->_))->o));
+
+	/* a one-shot fd is reported once, until it's re-armed */
+	assert(b6b_call_copy(&interp, "{$p mod [$b fd] [$| $POLLIN $POLLONESHOT]} {$return [$list.len [$list.index [$p wait 1 0] 0]]}", 94) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 1);
+	assert(b6b_call_copy(&interp, "{$return [$list.len [$list.index [$p wait 1 0] 0]]}", 51) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 0);
+	assert(b6b_call_copy(&interp, "{$p mod [$b fd] [$| $POLLIN $POLLONESHOT]} {$return [$list.len [$list.index [$p wait 1 0] 0]]}", 94) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 1);
+
+	/* an edge-triggered fd is reported again only when there's new data */
+	assert(b6b_call_copy(&interp, "{$p mod [$b fd] [$| $POLLIN $POLLET]} {$return [$list.len [$list.index [$p wait 1 0] 0]]}", 89) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 1);
+	assert(b6b_call_copy(&interp, "{$return [$list.len [$list.index [$p wait 1 0] 0]]}", 51) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 0);
+	assert(b6b_call_copy(&interp, "{$a write z} {$return [$list.len [$list.index [$p wait 1 0] 0]]}", 64) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 1);
+
+	/* POLLRDHUP reports a peer that stopped writing */
+	assert(b6b_call_copy(&interp, "{$p mod [$b fd] $POLLRDHUP} {$return [$list.len [$list.index [$p wait 1 0] 2]]}", 79) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 0);
+	assert(b6b_call_copy(&interp, "{$a close} {$return [$list.len [$list.index [$p wait 1 0] 2]]}", 62) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 1);
+	b6b_interp_destroy(&interp);
+
+#ifdef B6B_HAVE_THREADS
+	/* a thread waiting for events should not block other threads, with or
+	 * without io_uring */
+	for (i = 0; i < 2; ++i) {
+		if (i)
+			assert(setenv("B6B_NO_IO_URING", "1", 1) == 0);
+
+		assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+		assert(b6b_call_copy(&interp, "{$global p [$poll]} {$global ab [$un.pair stream]} {$global a [$list.index $ab 0]} {$global b [$list.index $ab 1]} {$p add [$b fd] $POLLIN}", 139) == B6B_OK);
+		assert(b6b_call_copy(&interp, "{$global f [$spawn {{$p wait 1 100}}]} {$f wait}", 48) == B6B_OK);
+		assert(b6b_as_str(interp.fg->_));
+		assert(strcmp(interp.fg->_->s, "{} {} {}") == 0);
+		assert(b6b_call_copy(&interp, "{$global f [$spawn {{$p wait 1 -1}}]} {$yield} {$a write x} {$return [$== [$list.index [$list.index [$f wait] 0] 0] [$b fd]]}", 125) == B6B_RET);
+		assert(b6b_obj_istrue(interp.fg->_));
+#	ifdef B6B_HAVE_IO_URING
+		/* if io_uring is available, it's used */
+		assert(!interp.uring.ok || (interp.uring.fd >= 0));
+		assert(!i || !interp.uring.ok);
+#	endif
+		b6b_interp_destroy(&interp);
+	}
+	assert(unsetenv("B6B_NO_IO_URING") == 0);
+#endif
+
 	return EXIT_SUCCESS;
 }
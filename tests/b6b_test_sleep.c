@@ -21,6 +21,7 @@
 #include <time.h>
 #include <signal.h>
 #include <unistd.h>
+#include <string.h>
 
 #include <b6b.h>
 
@@ -83,5 +84,35 @@ int main()
 	       ((double)ts1.tv_sec + (double)ts1.tv_nsec / 1000000000.0) < 2.1);
 	b6b_interp_destroy(&interp);
 
+#ifdef B6B_HAVE_THREADS
+	/* sleeping threads don't occupy offload threads, so they all sleep at the
+	 * same time */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(clock_gettime(CLOCK_MONOTONIC, &ts1) == 0);
+	assert(b6b_call_copy(&interp, "{$global fs [$map i [$range 1 64] {{$spawn {{$sleep 0.5}}}}]} {$map f $fs {{$f wait}}}", 86) == B6B_OK);
+	assert(clock_gettime(CLOCK_MONOTONIC, &ts2) == 0);
+	assert(((double)ts2.tv_sec + (double)ts2.tv_nsec / 1000000000.0) -
+	       ((double)ts1.tv_sec + (double)ts1.tv_nsec / 1000000000.0) > 0.4);
+	assert(((double)ts2.tv_sec + (double)ts2.tv_nsec / 1000000000.0) -
+	       ((double)ts1.tv_sec + (double)ts1.tv_nsec / 1000000000.0) < 0.9);
+	b6b_interp_destroy(&interp);
+
+	/* other threads run while a thread sleeps */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global x {}} {$spawn {{$sleep 0.2} {$list.append $x a}}} {$spawn {{$sleep 0.1} {$list.append $x b}}} {$spawn {{$list.append $x c}}} {$sleep 0.3} {$return $x}", 159) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "c b a") == 0);
+	b6b_interp_destroy(&interp);
+
+	/* sleeping threads exit with the interpreter */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(clock_gettime(CLOCK_MONOTONIC, &ts1) == 0);
+	assert(b6b_call_copy(&interp, "{$spawn {{$sleep 10}}}", 22) == B6B_OK);
+	b6b_interp_destroy(&interp);
+	assert(clock_gettime(CLOCK_MONOTONIC, &ts2) == 0);
+	assert(((double)ts2.tv_sec + (double)ts2.tv_nsec / 1000000000.0) -
+	       ((double)ts1.tv_sec + (double)ts1.tv_nsec / 1000000000.0) < 1);
+#endif
+
 	return EXIT_SUCCESS;
 }
@@ -31,6 +31,8 @@ int main()
 	b6b_interp_destroy(&interp);
 
 	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	/* switch threads after every statement */
+	b6b_set_quantum(&interp, 0);
 	assert(b6b_call_copy(
 	                &interp,
 	                "{$global x {}} " \
@@ -44,6 +46,8 @@ int main()
 	b6b_interp_destroy(&interp);
 
 	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	/* switch threads after every statement */
+	b6b_set_quantum(&interp, 0);
 	assert(b6b_call_copy(&interp,
 	                "{$global x {}} " \
 	                "{$spawn {{$map y [$range 1 20] {{$list.append $x a}}}}} " \
@@ -61,6 +65,8 @@ int main()
 	b6b_interp_destroy(&interp);
 
 	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	/* switch threads only when they yield or wait */
+	b6b_set_quantum(&interp, UINT64_MAX);
 	assert(b6b_call_copy(&interp,
 	        "{$global x {}} " \
 	        "{$spawn {{$map y [$range 1 3] {{$list.append $x a} {$yield}}}}} " \
@@ -79,5 +85,200 @@ int main()
 	                     15 + 30 + 18) == B6B_EXIT);
 	b6b_interp_destroy(&interp);
 
+	/* a stack size of 0 means the default size */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp,
+	                     "{$global x {}} " \
+	                     "{$spawn {{$list.append $x a}} 0 5} " \
+	                     "{$yield} " \
+	                     "{$return $x}",
+	                     15 + 35 + 9 + 12) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "a") == 0);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$spawn {} -1}", 14) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$spawn {} a}", 13) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	/* a thread may have a custom stack size */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp,
+	                     "{$global x {}} " \
+	                     "{$spawn {{$list.append $x a}} 100000} " \
+	                     "{$yield} " \
+	                     "{$return $x}",
+	                     15 + 38 + 9 + 12) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "a") == 0);
+	b6b_interp_destroy(&interp);
+
+	/* a tiny stack should be big enough to reach the nesting limit */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp,
+	                     "{$global r [$proc r {{$if [$> $1 0] {{$r [$- $1 1]}}}}]} " \
+	                     "{$global f [$spawn {{$r 100}} 1]} " \
+	                     "{$f wait}",
+	                     57 + 34 + 9) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	/* the default stack size may change while unused stacks are kept for
+	 * reuse, but not below the minimum */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{[$spawn {{$return a}}] wait}", 29) == B6B_OK);
+	assert(interp.stks.nfree == 1);
+	assert(!b6b_set_stack_size(&interp, interp.stks.size - 1));
+	assert(interp.stks.nfree == 1);
+	assert(b6b_set_stack_size(&interp, interp.stks.size * 2 + 1));
+	assert(interp.stks.nfree == 0);
+	assert(!(interp.stks.size % interp.stks.pgsiz));
+	assert(b6b_call_copy(&interp, "{[$spawn {{$return a}}] wait}", 29) == B6B_OK);
+	assert(interp.stks.nfree == 1);
+	b6b_interp_destroy(&interp);
+
+	/* stacks of finished threads are reused, and must be big enough for deep
+	 * recursion */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	/* switch threads only when they yield or wait */
+	b6b_set_quantum(&interp, UINT64_MAX);
+	assert(b6b_call_copy(&interp,
+	                     "{$global x 0} " \
+	                     "{$proc f {{$if [$> $1 0] {{$f [$- $1 1]}}}}} " \
+	                     "{$map i [$range 1 100] {{$spawn {{$f 30} {$global x [$+ $x 1]}}}}} " \
+	                     "{$loop {{$if [$== $x 100] {{$return $x}}} {$yield}}}",
+	                     14 + 45 + 67 + 52) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 100);
+	b6b_interp_destroy(&interp);
+
+	/* a thread reading from an empty stream is parked until there's data */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp,
+	                     "{$global x {}} " \
+	                     "{$global p [$un.pair stream]} " \
+	                     "{$spawn {{$list.append $x [[$list.index $p 1] read]}}} " \
+	                     "{$yield} " \
+	                     "{$list.append $x b} " \
+	                     "{[$list.index $p 0] write abcd} " \
+	                     "{$loop {{$if [$== [$list.len $x] 2] {{$return $x}}} {$yield}}}",
+	                     15 + 30 + 55 + 9 + 20 + 32 + 62) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "b abcd") == 0);
+	b6b_interp_destroy(&interp);
+
+	/* threads waiting to read from the same stream are parked until there's
+	 * data for each of them */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp,
+	                     "{$global x {}} " \
+	                     "{$global p [$un.pair stream]} " \
+	                     "{$global b [$list.index $p 1]} " \
+	                     "{$spawn {{$list.append $x [$b read]}}} " \
+	                     "{$spawn {{$list.append $x [$b read]}}} " \
+	                     "{$yield} " \
+	                     "{[$list.index $p 0] write ab} " \
+	                     "{$loop {{$if [$== [$list.len $x] 1] {{$break}}} {$yield}}} " \
+	                     "{[$list.index $p 0] write cd} " \
+	                     "{$loop {{$if [$== [$list.len $x] 2] {{$return $x}}} {$yield}}}",
+	                     15 + 30 + 31 + 39 + 39 + 9 + 30 + 59 + 30 + 62) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "ab cd") == 0);
+	b6b_interp_destroy(&interp);
+
+	/* a thread may write to a stream while another waits to read from it */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, 0));
+	assert(b6b_call_copy(&interp,
+	                     "{$global s a} " \
+	                     "{$map i [$range 1 20] {{$global s [$str.concat $s $s]}}} " \
+	                     "{$global x {}} " \
+	                     "{$global srv [$inet.server tcp 127.0.0.1 2925]} " \
+	                     "{$global a [$inet.client tcp 127.0.0.1 2925]} " \
+	                     "{$global b [$list.index [$srv accept] 0]} " \
+	                     "{$spawn {{$list.append $x [$b read]}}} " \
+	                     "{$spawn {{$list.append $x [$b write $s]}}} " \
+	                     "{$global n 0} " \
+	                     "{$loop {{$global n [$+ $n [$str.len [$a read]]]} {$if [$== $n 1048576] {{$break}}} {$yield}}} " \
+	                     "{$a write c} " \
+	                     "{$loop {{$if [$== [$list.len $x] 2] {{$return $x}}} {$yield}}}",
+	                     14 + 57 + 15 + 48 + 46 + 42 + 39 + 43 + 14 + 94 + 13 + 62) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "1048576 c") == 0);
+	b6b_interp_destroy(&interp);
+
+	/* a thread waiting for a stream should run even if other threads keep
+	 * yielding */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, 0));
+	assert(b6b_call_copy(&interp, "{$global ab [$un.pair stream]} {$global a [$list.index $ab 0]} {$global b [$list.index $ab 1]} {$global x {}} {$spawn {{$loop {{$if [$list.len $x] {{$break}}} {$yield}}}}} {$spawn {{$list.append $x [$b read]}}} {$yield} {$a write abc} {$loop {{$if [$list.len $x] {{$return $x}}} {$yield}}}", 289) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "abc") == 0);
+	b6b_interp_destroy(&interp);
+
+	/* parked threads should exit when the interpreter is destroyed */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp,
+	                     "{$global p [$un.pair stream]} " \
+	                     "{$spawn {{[$list.index $p 1] read}}} " \
+	                     "{$yield}",
+	                     30 + 37 + 8) == B6B_OK);
+	b6b_interp_destroy(&interp);
+
+	/* a woken thread with a higher priority runs before other threads, once
+	 * the time slice is over and file descriptors are polled */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp,
+	                     "{$global x {}} " \
+	                     "{$global p [$un.pair stream]} " \
+	                     "{$spawn {{$list.append $x [[$list.index $p 1] read]}} 65536 1} " \
+	                     "{$yield} " \
+	                     "{[$list.index $p 0] write abcd} " \
+	                     "{$spawn {{$list.append $x b}}} " \
+	                     "{$loop {{$if [$== [$list.len $x] 2] {{$return $x}}}}}",
+	                     15 + 30 + 63 + 9 + 32 + 31 + 53) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "abcd b") == 0);
+	b6b_interp_destroy(&interp);
+
+	/* the priority must be an integer */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$spawn {} 65536 a}", 19) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	/* spawn returns a handle that waits for the thread and its result */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global f [$spawn {{$yield} {$return a}}]} {$return [$f done]}", 63) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 0);
+	assert(b6b_call_copy(&interp, "{$f result}", 11) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$f}", 4) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$f a}", 6) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$return [$f wait]}", 19) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "a") == 0);
+	assert(b6b_call_copy(&interp, "{$return [$f done]}", 19) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 1);
+	assert(b6b_call_copy(&interp, "{$return [$f result]}", 21) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "a") == 0);
+	assert(b6b_call_copy(&interp, "{$global fs [$list.new [$spawn {{$yield} {$return 1}}] [$spawn {{$return 2}}] [$spawn {{$yield} {$yield} {$return 3}}]]} {$return [$str.join {} [$map f $fs {{$f wait}}]]}", 170) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "123") == 0);
+	assert(b6b_call_copy(&interp, "{$global g [$spawn {{$throw b}}]} {$g wait}", 43) == B6B_ERR);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "b") == 0);
+	assert(b6b_call_copy(&interp, "{$g result}", 11) == B6B_ERR);
+	/* a thread cannot wait for itself */
+	assert(b6b_call_copy(&interp, "{$global h [$spawn {{$h wait}}]} {$h wait}", 42) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	/* threads waiting for other threads exit with the interpreter */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global c [$chan]} {$global f [$spawn {{$c recv}}]} {$spawn {{$f wait}}}", 73) == B6B_OK);
+	b6b_interp_destroy(&interp);
+
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,106 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2026 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include <b6b.h>
+
+int main()
+{
+	struct b6b_interp interp;
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.uindex abc 0}", 19) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(interp.fg->_->slen == 1);
+	assert(strcmp(interp.fg->_->s, "a") == 0);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.uindex abc 2}", 19) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(interp.fg->_->slen == 1);
+	assert(strcmp(interp.fg->_->s, "c") == 0);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.uindex \xd7\xa9\xd7\x9c\xd7\x95\xd7\x9d 1}", 24) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(interp.fg->_->slen == 2);
+	assert(strcmp(interp.fg->_->s, "\xd7\x9c") == 0);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.uindex {a\xd7\xa9\xd7\x9c\xd7\x95\xd7\x9d" "b} 5}", 28) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(interp.fg->_->slen == 1);
+	assert(strcmp(interp.fg->_->s, "b") == 0);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.uindex \xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91" "c\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93 100}", 279) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(interp.fg->_->slen == 1);
+	assert(strcmp(interp.fg->_->s, "c") == 0);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.uindex \xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91" "c\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93 130}", 279) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(interp.fg->_->slen == 2);
+	assert(strcmp(interp.fg->_->s, "\xd7\x93") == 0);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.uindex \xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91" "c\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93 64}", 278) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(interp.fg->_->slen == 2);
+	assert(strcmp(interp.fg->_->s, "\xd7\x90") == 0);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.uindex \xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91" "c\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93 65}", 278) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(interp.fg->_->slen == 2);
+	assert(strcmp(interp.fg->_->s, "\xd7\x91") == 0);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.uindex abc 3}", 19) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.uindex abc -1}", 20) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.uindex \xd7\xa9\xd7\x9c\xd7\x95\xd7\x9d 4}", 24) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.uindex \xd7 0}", 17) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.uindex abc}", 17) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	return EXIT_SUCCESS;
+}
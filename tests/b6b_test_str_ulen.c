@@ -0,0 +1,86 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2026 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include <b6b.h>
+
+int main()
+{
+	struct b6b_interp interp;
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.ulen {}}", 14) == B6B_OK);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 0);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.ulen abc}", 15) == B6B_OK);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 3);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.ulen \xd7\xa9\xd7\x9c\xd7\x95\xd7\x9d}", 20) == B6B_OK);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 4);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.ulen {a\xd7\xa9\xd7\x9c\xd7\x95\xd7\x9d" "b}}", 24) == B6B_OK);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 6);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.ulen \xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91" "c\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93}", 273) == B6B_OK);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 131);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$local s \xd7\xa9\xd7\x9c\xd7\x95\xd7\x9d} {$str.ulen $s} {$str.ulen $s}", 49) == B6B_OK);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 4);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.ulen \xd7}", 13) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.ulen \xc0\xaf}", 14) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.ulen \xed\xa0\x80}", 15) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.ulen \xf4\x90\x80\x80}", 16) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.ulen}", 11) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,85 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2026 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include <b6b.h>
+
+int main()
+{
+	struct b6b_interp interp;
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.urange abc 0 2}", 21) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(interp.fg->_->slen == 3);
+	assert(strcmp(interp.fg->_->s, "abc") == 0);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.urange abc 1 1}", 21) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(interp.fg->_->slen == 1);
+	assert(strcmp(interp.fg->_->s, "b") == 0);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.urange \xd7\xa9\xd7\x9c\xd7\x95\xd7\x9d 1 2}", 26) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(interp.fg->_->slen == 4);
+	assert(strcmp(interp.fg->_->s, "\xd7\x9c\xd7\x95") == 0);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.urange {a\xd7\xa9\xd7\x9c\xd7\x95\xd7\x9d" "b} 0 1}", 30) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(interp.fg->_->slen == 3);
+	assert(strcmp(interp.fg->_->s, "a\xd7\xa9") == 0);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.urange \xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91\xd7\x90\xd7\x91" "c\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93\xd7\x93 99 101}", 282) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(interp.fg->_->slen == 5);
+	assert(strcmp(interp.fg->_->s, "\xd7\x91" "c\xd7\x93") == 0);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.urange abc 0 3}", 21) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.urange abc 2 1}", 21) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.urange \xd7\xa9\xd7\x9c\xd7\x95\xd7\x9d 0 4}", 26) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.urange \xd7 0 0}", 19) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$str.urange abc 0}", 19) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	return EXIT_SUCCESS;
+}
@@ -193,6 +193,145 @@ int main()
 	assert(strcmp(interp.fg->_->s, "abcdefgh") == 0);
 	teardown(&interp, fd, buf, sizeof(buf));
 
+	/* reading into a buffer should append to it */
+	setup(&interp, &b6b_memstream_ops, &o, &fd, sizeof(buf));
+	assert(b6b_call_copy(&interp, "{$local b [$buf xy]}", 20) == B6B_OK);
+	assert(b6b_call_copy(&interp, "{$f read_into $b 4}", 19) == B6B_OK);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 4);
+	assert(b6b_call_copy(&interp, "{$f read_into $b}", 17) == B6B_OK);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 4);
+	assert(b6b_call_copy(&interp, "{$f read_into $b}", 17) == B6B_OK);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 0);
+	assert(b6b_call_copy(&interp, "{$b take}", 9) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(interp.fg->_->slen == 10);
+	assert(strcmp(interp.fg->_->s, "xyabcdefgh") == 0);
+	teardown(&interp, fd, buf, sizeof(buf));
+
+	/* reading into something that isn't a buffer should fail */
+	setup(&interp, &b6b_memstream_ops, &o, &fd, sizeof(buf));
+	assert(b6b_call_copy(&interp, "{$f read_into abcd}", 19) == B6B_ERR);
+	teardown(&interp, fd, buf, sizeof(buf));
+
+	/* reading until a delimiter should keep the rest of the data */
+	setup(&interp, &b6b_memstream_ops, &o, &fd, sizeof(buf));
+	assert(b6b_call_copy(&interp, "{$f readuntil {}}", 17) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$f readuntil cd}", 17) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "abcd") == 0);
+	assert(b6b_call_copy(&interp, "{$f readuntil gh}", 17) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "efgh") == 0);
+	assert(b6b_call_copy(&interp, "{$f readuntil x}", 16) == B6B_ERR);
+	teardown(&interp, fd, buf, sizeof(buf));
+
+	/* at EOF, the last line may be incomplete */
+	setup(&interp, &b6b_slow_r_memstream_ops, &o, &fd, sizeof(buf));
+	assert(b6b_call_copy(&interp, "{$f readline}", 13) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "abcdefgh") == 0);
+	assert(b6b_call_copy(&interp, "{$f readline}", 13) == B6B_ERR);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "eof") == 0);
+	teardown(&interp, fd, buf, sizeof(buf));
+
+	/* lines longer than the limit should fail */
+	setup(&interp, &b6b_memstream_ops, &o, &fd, sizeof(buf));
+	assert(b6b_call_copy(&interp, "{$f readline 4}", 15) == B6B_ERR);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "no delimiter in 4 bytes") == 0);
+	assert(b6b_call_copy(&interp, "{$f readuntil e 4}", 18) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$f readuntil d 4}", 18) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "abcd") == 0);
+	teardown(&interp, fd, buf, sizeof(buf));
+
+	/* the limit should apply to data read ahead too */
+	setup(&interp, &b6b_memstream_ops, &o, &fd, sizeof(buf));
+	assert(b6b_call_copy(&interp, "{$f readuntil b}", 16) == B6B_OK);
+	assert(b6b_call_copy(&interp, "{$f readuntil h 4}", 18) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$f readuntil f 4}", 18) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "cdef") == 0);
+	teardown(&interp, fd, buf, sizeof(buf));
+
+	/* reading an exact amount should fail if there's not enough data, but the
+	 * data should be kept */
+	setup(&interp, &b6b_memstream_ops, &o, &fd, sizeof(buf));
+	assert(b6b_call_copy(&interp, "{$f readexact 0}", 16) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$f readexact 3}", 16) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "abc") == 0);
+	assert(b6b_call_copy(&interp, "{$f readexact 3}", 16) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "def") == 0);
+	assert(b6b_call_copy(&interp, "{$f readexact 3}", 16) == B6B_ERR);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "eof after 2 bytes") == 0);
+	assert(b6b_call_copy(&interp, "{$f read}", 9) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "gh") == 0);
+	teardown(&interp, fd, buf, sizeof(buf));
+
+	/* data read ahead should be returned by read and read_into */
+	setup(&interp, &b6b_memstream_ops, &o, &fd, sizeof(buf));
+	assert(b6b_call_copy(&interp, "{$f readuntil b}", 16) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "ab") == 0);
+	assert(b6b_call_copy(&interp, "{$f read 2}", 11) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "cd") == 0);
+	assert(b6b_call_copy(&interp, "{$local b [$buf]} {$f read_into $b}", 35) == B6B_OK);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 4);
+	assert(b6b_call_copy(&interp, "{$b take}", 9) == B6B_OK);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "efgh") == 0);
+	teardown(&interp, fd, buf, sizeof(buf));
+
+	/* incomplete lines should be kept until the rest arrives */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global ab [$un.pair stream]} {$global a [$list.index $ab 0]} {$global b [$list.index $ab 1]} {$a write ab} {$return [$b readline]}", 132) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(!interp.fg->_->slen);
+	assert(b6b_call_copy(&interp, "{$a write [$str.expand {c\\nd}]} {$return [$b readline]}", 55) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "abc\n") == 0);
+	assert(b6b_call_copy(&interp, "{$return [$b readline]}", 23) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(!interp.fg->_->slen);
+	assert(b6b_call_copy(&interp, "{$a close} {$return [$b readline]}", 34) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "d") == 0);
+	assert(b6b_call_copy(&interp, "{$b readline}", 13) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	/* data already searched for one delimiter may contain another, and a
+	 * delimiter may arrive in pieces */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global ab [$un.pair stream]} {$global a [$list.index $ab 0]} {$global b [$list.index $ab 1]} {$a write xyz} {$return [$b readuntil q]}", 136) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(!interp.fg->_->slen);
+	assert(b6b_call_copy(&interp, "{$return [$b readuntil y]}", 26) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "xy") == 0);
+	assert(b6b_call_copy(&interp, "{$a write [$str.expand {q\\r}]} {$return [$b readuntil q]}", 57) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "zq") == 0);
+	assert(b6b_call_copy(&interp, "{$return [$b readuntil [$str.expand {\\r\\n}]]}", 45) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(!interp.fg->_->slen);
+	assert(b6b_call_copy(&interp, "{$a write [$str.expand {\\nab}]} {$return [$b readuntil [$str.expand {\\r\\n}]]}", 77) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "\r\n") == 0);
+	assert(b6b_call_copy(&interp, "{$return [$b readuntil b]}", 26) == B6B_RET);
+	assert(b6b_as_str(interp.fg->_));
+	assert(strcmp(interp.fg->_->s, "ab") == 0);
+	b6b_interp_destroy(&interp);
+
 	/* a file descriptor should hold a reference to keep the stream open */
 	setup(&interp, &b6b_memstream_ops, &o, &fd, sizeof(buf));
 	refc = o->refc;
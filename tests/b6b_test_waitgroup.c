@@ -0,0 +1,68 @@
+/*
+ * This file is part of b6b.
+ *
+ * Copyright 2026 Dima Krasner
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include <b6b.h>
+
+int main()
+{
+	struct b6b_interp interp;
+
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$waitgroup a}", 14) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$global wg [$waitgroup]}", 25) == B6B_OK);
+	assert(b6b_call_copy(&interp, "{$wg}", 5) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$wg a}", 7) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$wg add a}", 11) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$wg wait}", 10) == B6B_OK);
+	/* the counter cannot be negative */
+	assert(b6b_call_copy(&interp, "{$wg done}", 10) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$wg add -1}", 12) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$wg add} {$wg add 2} {$return [$wg len]}", 41) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 3);
+	assert(b6b_call_copy(&interp, "{$global x {}} {$map i {1 2 3} {{$spawn {{$yield} {$list.append $x a} {$wg done}}}}} {$wg wait} {$return [$list.len $x]}", 120) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 3);
+	assert(b6b_call_copy(&interp, "{$return [$wg len]}", 19) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == 0);
+	/* no thread can call done */
+	assert(b6b_call_copy(&interp, "{$wg add} {$wg wait}", 20) == B6B_ERR);
+	b6b_interp_destroy(&interp);
+
+	/* the counter cannot overflow */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global wg [$waitgroup]} {$wg add 9223372036854774784} {$wg add 1023}", 70) == B6B_OK);
+	assert(b6b_call_copy(&interp, "{$wg add}", 9) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$wg add 9223372036854774784}", 29) == B6B_ERR);
+	assert(b6b_call_copy(&interp, "{$return [$wg len]}", 19) == B6B_RET);
+	assert(b6b_as_int(interp.fg->_));
+	assert(interp.fg->_->i == B6B_INT_MAX);
+	b6b_interp_destroy(&interp);
+
+	/* threads waiting for a wait group exit with the interpreter */
+	assert(b6b_interp_new_argv(&interp, 0, NULL, B6B_OPT_TRACE));
+	assert(b6b_call_copy(&interp, "{$global wg [$waitgroup]} {$wg add} {$spawn {{$wg wait}}}", 57) == B6B_OK);
+	b6b_interp_destroy(&interp);
+
+	return EXIT_SUCCESS;
+}